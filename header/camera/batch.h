@@ -0,0 +1,40 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "camera/camera.h"
+
+#include <algorithm>
+#include <vector>
+
+/*
+    Renders several views of one scene together (stereo pairs, turntables, contact sheets).
+    All views trace against the same read-only world. Every view is cut into tiles and the
+    tiles of all views go into one task group on the shared pool, so workers that finish
+    one view's tiles go straight on to another's instead of idling at the end of each frame.
+*/
+
+inline void render_batch(const hittable& world, std::vector<camera>& views, std::vector<image_buffer>& images,
+                         thread_pool& pool, int tile_size = 32) {
+    images.resize(views.size());
+    for (size_t v = 0; v < views.size(); v++)
+        views[v].begin_frame(images[v]);
+
+    task_group tiles(pool);
+    for (size_t v = 0; v < views.size(); v++) {
+        const camera& cam = views[v];
+        image_buffer& img = images[v];
+
+        for (int y0 = 0; y0 < img.height; y0 += tile_size) {
+            for (int x0 = 0; x0 < img.width; x0 += tile_size) {
+                int x1 = std::min(x0 + tile_size, img.width);
+                int y1 = std::min(y0 + tile_size, img.height);
+                tiles.run([&world, &cam, &img, x0, y0, x1, y1] {
+                    cam.render_tile(world, img, x0, y0, x1, y1);
+                });
+            }
+        }
+    }
+    tiles.wait();
+}
+
+#endif
@@ -3,6 +3,50 @@
 
 #include "objects/hittable.h"
 #include "objects/material.h"
+#include "utils/cost_map.h"
+#include "utils/image.h"
+#include "utils/thread_pool.h"
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// The materials (and whether the sky) a pixel's light paths touched. Incremental re-rendering
+// uses it to find the pixels an edit can change.
+struct path_record {
+    std::vector<const material*> materials;
+    bool sky = false;
+
+    void touch(const material* mat) {
+        if (std::find(materials.begin(), materials.end(), mat) == materials.end())
+            materials.push_back(mat);
+    }
+};
+
+// What a time-budgeted render achieved: the samples per pixel it reached and how long each pass took.
+struct budget_report {
+    struct pass {
+        int    samples;  // Samples per pixel requested by the pass
+        bool   complete; // False if the deadline cut the pass short
+        double ms;       // Wall time of the pass
+    };
+
+    std::vector<pass> passes;
+    int    min_spp  = 0;  // Fewest samples any pixel received
+    double mean_spp = 0;  // Average samples per pixel over the frame
+    double total_ms = 0;
+
+    void print(std::ostream& out) const {
+        for (size_t i = 0; i < passes.size(); i++) {
+            out << "Pass " << i << ": " << passes[i].samples << " spp in " << passes[i].ms << " ms"
+                << (passes[i].complete ? "" : " (cut short by deadline)") << '\n';
+        }
+        out << "Achieved " << mean_spp << " spp on average (minimum " << min_spp << ") in "
+            << total_ms << " ms\n";
+    }
+};
 
 
 class camera {
@@ -20,6 +64,17 @@ class camera {
     double defocus_angle = 0;  // Variation angle of rays through each pixel
     double focus_dist = 10;    // Distance from camera lookfrom point to plane of perfect focus
 
+    // With deterministic sampling every sample draws its random numbers from a stream seeded by
+    // (seed, pixel, sample index), so the image is bit-identical whatever the thread count or
+    // the order pixels are rendered in. Without it, samples continue the per-thread stream.
+    bool     deterministic = true;
+    uint64_t seed          = 0;
+
+    color sky_top    = color(0.5, 0.7, 1.0);  // Sky color straight up
+    color sky_bottom = color(1.0, 1.0, 1.0);  // Sky color straight down
+
+    cost_map* costs = nullptr;  // If set, filled with the per-pixel cost of each render
+
 
     void render(const hittable& world) {
         initialize();
@@ -28,20 +83,117 @@ class camera {
 
         for (int j = 0; j < image_height; j++) {
             std::clog << "\rScanlines remaining: " << (image_height - j) << ' ' << std::flush;
-            for (int i = 0; i < image_width; i++) {
-                color pixel_color(0,0,0);
-                for (int sample = 0; sample < samples_per_pixel; sample++) {
-                    ray r = get_ray(i, j);
-                    pixel_color += ray_color(r, max_depth, world);
-                }
-                write_color(std::cout, pixel_samples_scale * pixel_color);
-            }
+            TRACE_SCOPE("scanline");
+            for (int i = 0; i < image_width; i++)
+                write_color(std::cout, render_pixel(i, j, world));
         }
 
         std::clog << "\rDone.                 \n";
     }
 
+    // Render into an in-memory frame. With a pool, scanlines are rendered as independent
+    // tasks on its workers; the call returns once the whole frame is complete.
+    void render(const hittable& world, image_buffer& img, thread_pool* pool = nullptr) {
+        initialize();
+        img.resize(image_width, image_height);
+
+        auto render_row = [this, &world, &img](int j) {
+            for (int i = 0; i < image_width; i++)
+                img.at(i, j) = render_pixel(i, j, world);
+        };
+
+        for_each_row(pool, render_row);
+    }
+
+    // Building blocks for schedulers that split frames themselves (see batch.h): set the camera
+    // up and size the frame, then render rectangles [x0,x1) x [y0,y1) of it in any order, from
+    // any thread.
+    void begin_frame(image_buffer& img) {
+        initialize();
+        img.resize(image_width, image_height);
+    }
+
+    void render_tile(const hittable& world, image_buffer& img, int x0, int y0, int x1, int y1) const {
+        TRACE_SCOPE("tile");
+        for (int j = y0; j < y1; j++)
+            for (int i = x0; i < x1; i++)
+                img.at(i, j) = render_pixel(i, j, world);
+    }
+
+    // Render the best image possible within `seconds` of wall time. The frame is rendered in
+    // full-frame passes of growing sample counts; the cost of a pass is predicted from the
+    // passes so far, and no pass is started that is not expected to finish in time. If a pass
+    // does overrun, rows not yet started are skipped. Each pixel is normalized by its own
+    // sample count, so pixels that got one pass more than their neighbours stay correct.
+    // The first pass (one sample everywhere) always completes. samples_per_pixel caps the total.
+    void render(const hittable& world, image_buffer& img, double seconds, thread_pool* pool,
+                budget_report* report = nullptr) {
+        using clock = std::chrono::steady_clock;
+
+        initialize();
+        img.resize(image_width, image_height);
+
+        auto start = clock::now();
+        auto deadline = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+
+        std::vector<color> sums(img.pixels.size(), color(0,0,0));
+        std::vector<int> counts(img.pixels.size(), 0);
+        budget_report local_report;
+        auto& rep = report ? *report : local_report;
+        rep = budget_report();
+
+        int samples_done = 0;  // Samples every pixel has received from complete passes
+        int pass_samples = 1;
+
+        while (pass_samples > 0) {
+            TRACE_SCOPE("pass");
+            auto pass_start = clock::now();
+            bool first_pass = samples_done == 0;
+            std::atomic<bool> cut_short{false};
+
+            auto render_row = [&, first_pass](int j) {
+                if (!first_pass && clock::now() >= deadline) {
+                    cut_short = true;
+                    return;
+                }
+                for (int i = 0; i < image_width; i++) {
+                    auto index = size_t(j) * image_width + i;
+                    sums[index] = sample_pixel(i, j, samples_done, pass_samples, world, sums[index]);
+                    counts[index] += pass_samples;
+                }
+            };
+            for_each_row(pool, render_row);
+
+            auto now = clock::now();
+            rep.passes.push_back({pass_samples, !cut_short,
+                                  std::chrono::duration<double, std::milli>(now - pass_start).count()});
+            if (cut_short)
+                break;
+            samples_done += pass_samples;
+
+            // Predict from the average cost of one sample per pixel so far. Doubling at most
+            // keeps a bad early estimate from committing to one huge pass.
+            double seconds_per_sample = std::chrono::duration<double>(now - start).count() / samples_done;
+            double seconds_left = std::chrono::duration<double>(deadline - now).count();
+            double affordable = seconds_left / seconds_per_sample;
+
+            pass_samples = std::min({ 2 * pass_samples, samples_per_pixel - samples_done,
+                                      int(std::min(affordable, double(samples_per_pixel))) });
+        }
+
+        rep.min_spp = counts.empty() ? 0 : *std::min_element(counts.begin(), counts.end());
+        double total = 0;
+        for (size_t index = 0; index < img.pixels.size(); index++) {
+            img.pixels[index] = sums[index] / counts[index];
+            total += counts[index];
+        }
+        rep.mean_spp = counts.empty() ? 0 : total / counts.size();
+        rep.total_ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
+
   private:
+    friend class incremental_renderer;
+
     int    image_height;         // Rendered image height
     double pixel_samples_scale;  // Color scale factor for a sum of pixel samples
     point3 center;               // Camera center
@@ -53,11 +205,16 @@ class camera {
     vec3   defocus_disk_v;       // Defocus disk vertical radius
 
     void initialize() {
+        TRACE_SCOPE("camera::initialize");
+
         image_height = int(image_width / aspect_ratio);
         image_height = (image_height < 1) ? 1 : image_height;
 
         pixel_samples_scale = 1.0 / samples_per_pixel;
 
+        if (costs)
+            costs->resize(image_width, image_height);
+
         center = lookfrom;
 
         // Determine viewport dimensions.
@@ -90,25 +247,108 @@ class camera {
         defocus_disk_v = v * defocus_radius;
     }
 
-    color ray_color(const ray& r, int depth, const hittable& world) const {
+    // Runs render_row(j) for every scanline, as tasks on the pool if there is one.
+    template <typename Row>
+    void for_each_row(thread_pool* pool, const Row& render_row) const {
+        if (!pool) {
+            for (int j = 0; j < image_height; j++) {
+                TRACE_SCOPE("scanline");
+                render_row(j);
+            }
+            return;
+        }
+
+        task_group rows(*pool);
+        for (int j = 0; j < image_height; j++) {
+            rows.run([&render_row, j] {
+                TRACE_SCOPE("scanline");
+                render_row(j);
+            });
+        }
+        rows.wait();
+    }
+
+    color render_pixel(int i, int j, const hittable& world) const {
+        return pixel_samples_scale * sample_pixel(i, j, 0, samples_per_pixel, world);
+    }
+
+    // Sum (not average) of samples [first_sample, first_sample + count) of pixel i, j, added one
+    // by one onto `sum`. Continuing a running sum rather than adding up per-pass totals keeps the
+    // floating-point order, so a time-budgeted render matches a full one sample for sample.
+    // With a cost map attached, the time and work spent are added to the pixel's entry. Costs
+    // accumulate, so time-budgeted passes over the same pixel add up.
+    color sample_pixel(int i, int j, int first_sample, int count, const hittable& world,
+                       color sum = color(0,0,0)) const {
+        if (!costs)
+            return trace_samples(i, j, first_sample, count, world, sum);
+
+        auto& counters = thread_counters();
+        ray_counters before = counters;
+        counters.deepest_bounce = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        color pixel_color = trace_samples(i, j, first_sample, count, world, sum);
+
+        auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        auto index = size_t(j) * image_width + i;
+        costs->nanoseconds[index]     += float(ns);
+        costs->rays[index]            += float(counters.rays - before.rays);
+        costs->primitive_tests[index] += float(counters.primitive_tests - before.primitive_tests);
+        costs->box_tests[index]       += float(counters.box_tests - before.box_tests);
+        costs->depth[index] = std::max(costs->depth[index], float(counters.deepest_bounce));
+        return pixel_color;
+    }
+
+    color trace_samples(int i, int j, int first_sample, int count, const hittable& world, color pixel_color) const {
+        for (int sample = first_sample; sample < first_sample + count; sample++) {
+            seed_sample(i, j, sample);
+            ray r = get_ray(i, j);
+            pixel_color += ray_color(r, max_depth, world);
+        }
+        return pixel_color;
+    }
+
+    void seed_sample(int i, int j, int sample) const {
+        if (deterministic)
+            seed_random(sample_stream_seed(seed, uint64_t(j) * image_width + i, sample));
+    }
+
+    color ray_color(const ray& r, int depth, const hittable& world, path_record* path = nullptr) const {
         // If we've exceeded the ray bounce limit, no more light is gathered.
         if (depth <= 0)
             return color(0,0,0);
+
+        auto& counters = thread_counters();
+        counters.rays++;
+        counters.deepest_bounce = std::max(counters.deepest_bounce, max_depth - depth);
         
         hit_record rec;
 
         // prevent self intersection that causes shadow acne by using 0.001 off the intersection point
-        if (world.hit(r, interval(0.001, infinity), rec)) {
-            ray scattered;
-            color attenuation;
-            if (rec.mat->scatter(r, rec, attenuation, scattered))
-                return attenuation * ray_color(scattered, depth-1, world);
-            return color(0,0,0);
-        }
+        if (world.hit(r, interval(0.001, infinity), rec))
+            return shade(r, rec, depth, world, path);
+
+        if (path)
+            path->sky = true;
+        return sky_color(r);
+    }
+
+    // Continue the path of ray r from its (already found) hit rec.
+    color shade(const ray& r, const hit_record& rec, int depth, const hittable& world, path_record* path) const {
+        if (path)
+            path->touch(rec.mat.get());
+
+        ray scattered;
+        color attenuation;
+        if (rec.mat->scatter(r, rec, attenuation, scattered))
+            return attenuation * ray_color(scattered, depth-1, world, path);
+        return color(0,0,0);
+    }
 
+    color sky_color(const ray& r) const {
         vec3 unit_direction = unit_vector(r.direction());
         auto a = 0.5*(unit_direction.y() + 1.0);
-        return (1.0-a)*color(1.0, 1.0, 1.0) + a*color(0.5, 0.7, 1.0);
+        return (1.0-a)*sky_bottom + a*sky_top;
     }
 
     ray get_ray(int i, int j) const {
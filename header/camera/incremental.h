@@ -0,0 +1,170 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "camera/camera.h"
+#include "utils/arena.h"
+
+#include <vector>
+
+/*
+    Incremental re-rendering for look development. The first render keeps a G-buffer with
+    the first hit of every camera sample (distance, normal, material, front_face) and, per
+    pixel, the set of materials and whether the sky was reached anywhere along its paths.
+
+    After editing a material's parameters (or the camera's sky colors), call
+    material_changed() / sky_changed() and then update(): only the pixels whose paths touched
+    the edit are re-rendered, and they skip primary intersection by starting from their cached
+    first hits. Geometry and camera placement must not change between updates.
+
+    Rendering is deterministic, so each sample replays the same primary ray and an updated
+    frame is identical to a full render with the edited scene.
+
+    Memory is one first-hit record (about 48 bytes) per sample, so this is meant for
+    look-dev resolutions and sample counts rather than final frames.
+*/
+
+class incremental_renderer {
+  public:
+    incremental_renderer(const camera& cam, const hittable& world, thread_pool* pool = nullptr)
+      : cam(cam), world(world), pool(pool)
+    {
+        this->cam.deterministic = true;
+    }
+
+    // Camera settings; only the sky colors may be edited between updates (followed by sky_changed()).
+    camera& view() { return cam; }
+
+    const image_buffer& frame() const { return img; }
+
+    // Full render, filling the G-buffer.
+    const image_buffer& render() {
+        cam.initialize();
+        img.resize(cam.image_width, cam.image_height);
+
+        auto pixels = img.pixels.size();
+        first_hits.assign(pixels * size_t(cam.samples_per_pixel), first_hit());
+        paths.assign(pixels, path_record());
+
+        cam.for_each_row(pool, [this](int j) {
+            for (int i = 0; i < cam.image_width; i++)
+                render_pixel(i, j, true);
+        });
+
+        dirty.assign(pixels, false);
+        return img;
+    }
+
+    // Marks every pixel whose paths touched `mat` for re-rendering. Returns how many were marked.
+    size_t material_changed(const material* mat) {
+        size_t marked = 0;
+        for (size_t index = 0; index < paths.size(); index++) {
+            const auto& touched = paths[index].materials;
+            if (std::find(touched.begin(), touched.end(), mat) != touched.end())
+                marked += mark(index);
+        }
+        return marked;
+    }
+
+    // Marks every pixel with a path that reached the sky for re-rendering.
+    size_t sky_changed() {
+        size_t marked = 0;
+        for (size_t index = 0; index < paths.size(); index++) {
+            if (paths[index].sky)
+                marked += mark(index);
+        }
+        return marked;
+    }
+
+    // Re-renders the marked pixels from their cached first hits. Does nothing before render().
+    const image_buffer& update() {
+        if (dirty.empty())
+            return img;
+
+        cam.for_each_row(pool, [this](int j) {
+            for (int i = 0; i < cam.image_width; i++) {
+                if (dirty[size_t(j) * cam.image_width + i])
+                    render_pixel(i, j, false);
+            }
+        });
+
+        dirty.assign(dirty.size(), false);
+        return img;
+    }
+
+  private:
+    // Where a camera sample's primary ray first hit; mat is null if it went straight to the sky.
+    struct first_hit {
+        double    t = 0;
+        vec3      normal;
+        material* mat = nullptr;
+        bool      front_face = false;
+    };
+
+    camera                   cam;
+    const hittable&          world;
+    thread_pool*             pool;
+    image_buffer             img;
+    std::vector<first_hit>   first_hits;  // samples_per_pixel entries per pixel, pixel-major
+    std::vector<path_record> paths;       // What each pixel's paths touched
+    std::vector<char>        dirty;       // Pixels to re-render on the next update()
+
+    size_t mark(size_t index) {
+        if (dirty[index])
+            return 0;
+        dirty[index] = true;
+        return 1;
+    }
+
+    // Renders pixel i, j. The first render traces primary rays and records their hits; later
+    // renders regenerate the same primary rays (keeping the sample's random stream in step)
+    // but take the hit from the cache.
+    void render_pixel(int i, int j, bool trace_primary) {
+        auto index = size_t(j) * cam.image_width + i;
+        auto* hits = &first_hits[index * cam.samples_per_pixel];
+        path_record path;
+
+        color pixel_color(0,0,0);
+        for (int sample = 0; sample < cam.samples_per_pixel; sample++) {
+            cam.seed_sample(i, j, sample);
+            ray r = cam.get_ray(i, j);
+
+            if (cam.max_depth <= 0)
+                continue;
+
+            auto& cached = hits[sample];
+            hit_record rec;
+
+            if (trace_primary) {
+                if (world.hit(r, interval(0.001, infinity), rec)) {
+                    cached.t = rec.t;
+                    cached.normal = rec.normal;
+                    cached.mat = rec.mat.get();
+                    cached.front_face = rec.front_face;
+                } else {
+                    cached.mat = nullptr;
+                }
+            }
+
+            if (!cached.mat) {
+                path.sky = true;
+                pixel_color += cam.sky_color(r);
+                continue;
+            }
+
+            rec.t = cached.t;
+            rec.p = r.at(cached.t);
+            rec.normal = cached.normal;
+            rec.front_face = cached.front_face;
+            // Non-owning: the scene keeps its materials alive, and this avoids reference
+            // count traffic on materials shared by many pixels.
+            rec.mat = borrow(cached.mat);
+
+            pixel_color += cam.shade(r, rec, cam.max_depth, world, &path);
+        }
+
+        img.at(i, j) = cam.pixel_samples_scale * pixel_color;
+        paths[index] = std::move(path);
+    }
+};
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef AABB_H
+#define AABB_H
+
+#include "core/interval.h"
+#include "core/ray.h"
+
+/*
+    Slab test shared by every box intersection (aabb, cube, and the flat BVHs in
+    compact_scene). slab_span gives the range of t over which the ray is between two planes
+    perpendicular to one axis, nearest plane first; a box is hit where the ranges of all three
+    axes and ray_t overlap.
+
+    The near and far planes are picked with the ray's precomputed sign instead of comparing
+    the two t values, and the narrowing below uses selects that compile to min/max without
+    branches. A ray parallel to an axis gives +-infinity from its infinite reciprocal, which
+    narrows correctly. The one NaN case, a parallel ray lying exactly in a slab plane (0 times
+    infinity), fails both comparisons and so leaves the range alone: the ray counts as inside.
+*/
+
+inline void slab_span(const ray& r, int axis, double lo, double hi, double& t_near, double& t_far) {
+    double inv = r.inverse_direction()[axis];
+    double orig = r.origin()[axis];
+    // Indexed rather than a ?: on the sign, which compilers turn into a mispredicted branch.
+    const double bounds[2] = { lo, hi };
+    int sign = r.sign(axis);
+    t_near = (bounds[sign] - orig) * inv;
+    t_far  = (bounds[1 - sign] - orig) * inv;
+}
+
+// Narrows [t_min, t_max] to the part of the ray between lo and hi along one axis.
+inline void clip_slab(const ray& r, int axis, double lo, double hi, double& t_min, double& t_max) {
+    double t_near, t_far;
+    slab_span(r, axis, lo, hi, t_near, t_far);
+    t_min = t_near > t_min ? t_near : t_min;
+    t_max = t_far < t_max ? t_far : t_max;
+}
+
+// True if the ray meets the box [lo, hi] within ray_t, with the entry point in t_enter.
+template <typename Bound>
+inline bool slab_hit(const ray& r, const Bound lo[3], const Bound hi[3], const interval& ray_t, double& t_enter) {
+    double t_min = ray_t.min, t_max = ray_t.max;
+    clip_slab(r, 0, lo[0], hi[0], t_min, t_max);
+    clip_slab(r, 1, lo[1], hi[1], t_min, t_max);
+    clip_slab(r, 2, lo[2], hi[2], t_min, t_max);
+    t_enter = t_min;
+    return t_min <= t_max;
+}
+
+// Where the ray first meets the surface of the solid box [lo, hi] within ray_t: the face it
+// enters through, or, for a ray that starts inside (no near plane past ray_t.min), the face it
+// leaves through. Sets t and the outward normal of that face. Used by cube-shaped primitives.
+inline bool box_surface_hit(const ray& r, const double lo[3], const double hi[3], const interval& ray_t,
+                            double& t, vec3& normal) {
+    double t_near[3], t_far[3];
+    for (int i = 0; i < 3; ++i)
+        slab_span(r, i, lo[i], hi[i], t_near[i], t_far[i]);
+
+    // The ray enters through the face of the axis whose near plane it crosses last.
+    auto t_min = ray_t.min;
+    auto t_max = ray_t.max;
+    int face = -1;
+    for (int i = 0; i < 3; ++i) {
+        bool later = t_near[i] > t_min;
+        t_min = later ? t_near[i] : t_min;
+        face = later ? i : face;
+        t_max = t_far[i] < t_max ? t_far[i] : t_max;
+    }
+
+    if (t_min > t_max) return false;
+
+    normal = vec3(0, 0, 0);
+    if (face >= 0) {
+        t = t_min;
+        normal[face] = r.sign(face) ? 1 : -1;
+        return true;
+    }
+
+    // Rare, so kept off the path above: the ray starts inside, and leaves through the face of
+    // the axis whose far plane it crosses first, if that lies within ray_t.
+    if (!(t_max < ray_t.max)) return false;
+    for (int i = 0; i < 3; ++i) {
+        if (t_far[i] == t_max)
+            face = i;
+    }
+    t = t_max;
+    normal[face] = r.sign(face) ? -1 : 1;
+    return true;
+}
+
+/*
+    Axis-aligned bounding box, stored as one interval per axis. A ray hits the box
+    when the overlap of its three slab intervals (x, y and z) is non-empty.
+*/
+
+class aabb {
+  public:
+    interval x, y, z;
+
+    aabb() {} // The default AABB is empty, since intervals are empty by default.
+
+    aabb(const interval& x, const interval& y, const interval& z)
+      : x(x), y(y), z(z)
+    {
+        pad_to_minimums();
+    }
+
+    aabb(const point3& a, const point3& b) {
+        // Treat the two points a and b as extrema for the bounding box, so we don't require a
+        // particular minimum/maximum coordinate order.
+        x = (a[0] <= b[0]) ? interval(a[0], b[0]) : interval(b[0], a[0]);
+        y = (a[1] <= b[1]) ? interval(a[1], b[1]) : interval(b[1], a[1]);
+        z = (a[2] <= b[2]) ? interval(a[2], b[2]) : interval(b[2], a[2]);
+
+        pad_to_minimums();
+    }
+
+    aabb(const aabb& box0, const aabb& box1) {
+        x = interval(box0.x, box1.x);
+        y = interval(box0.y, box1.y);
+        z = interval(box0.z, box1.z);
+    }
+
+    const interval& axis_interval(int n) const {
+        if (n == 1) return y;
+        if (n == 2) return z;
+        return x;
+    }
+
+    bool hit(const ray& r, interval ray_t) const {
+        double t_enter;
+        return hit(r, ray_t, t_enter);
+    }
+
+    // As above, also giving where the ray enters the box.
+    bool hit(const ray& r, interval ray_t, double& t_enter) const {
+        double t_min = ray_t.min, t_max = ray_t.max;
+        clip_slab(r, 0, x.min, x.max, t_min, t_max);
+        clip_slab(r, 1, y.min, y.max, t_min, t_max);
+        clip_slab(r, 2, z.min, z.max, t_min, t_max);
+        t_enter = t_min;
+        return t_min <= t_max;
+    }
+
+    // Returns the index of the longest axis of the bounding box.
+    int longest_axis() const {
+        if (x.size() > y.size())
+            return x.size() > z.size() ? 0 : 2;
+        else
+            return y.size() > z.size() ? 1 : 2;
+    }
+
+    point3 centroid() const {
+        return point3(0.5*(x.min + x.max), 0.5*(y.min + y.max), 0.5*(z.min + z.max));
+    }
+
+    static const aabb empty, universe;
+
+  private:
+
+    void pad_to_minimums() {
+        // Adjust the AABB so that no side is narrower than some delta, padding if necessary.
+        double delta = 0.0001;
+        if (x.size() < delta) x = x.expand(delta);
+        if (y.size() < delta) y = y.expand(delta);
+        if (z.size() < delta) z = z.expand(delta);
+    }
+};
+
+const aabb aabb::empty    = aabb(interval::empty,    interval::empty,    interval::empty);
+const aabb aabb::universe = aabb(interval::universe, interval::universe, interval::universe);
+
+#endif
@@ -9,6 +9,12 @@ class interval {
 
     interval(double min, double max) : min(min), max(max) {}
 
+    // Create the interval tightly enclosing the two input intervals.
+    interval(const interval& a, const interval& b) {
+        min = a.min <= b.min ? a.min : b.min;
+        max = a.max >= b.max ? a.max : b.max;
+    }
+
     double size() const {
         return max - min;
     }
@@ -27,6 +33,12 @@ class interval {
         return x;
     }
 
+    // Pad the interval by delta/2 on both sides (keeps flat boxes from having zero thickness).
+    interval expand(double delta) const {
+        auto padding = delta/2;
+        return interval(min - padding, max + padding);
+    }
+
     static const interval empty, universe;
 };
 
@@ -19,17 +19,31 @@
     , you get only the parts in front of 𝐀
     , and this is what is often called a half-line or a ray
 
+    Every box test along the ray needs 1/𝐛 and the sign of each component, so they are
+    worked out once when the ray is made rather than in each test.
 */
 
 class ray {
   public:
     ray() {}
 
-    ray(const point3& origin, const vec3& direction) : orig(origin), dir(direction) {}
+    ray(const point3& origin, const vec3& direction)
+      : orig(origin), dir(direction), inv_dir(1.0 / direction.x(), 1.0 / direction.y(), 1.0 / direction.z())
+    {
+        // Taken from the reciprocal so that a -0 component counts as negative.
+        for (int axis = 0; axis < 3; axis++)
+            dir_sign[axis] = inv_dir[axis] < 0;
+    }
 
     const point3& origin() const  { return orig; }
     const vec3& direction() const { return dir; }
 
+    // Componentwise 1/direction; an axis the ray is parallel to gives +-infinity.
+    const vec3& inverse_direction() const { return inv_dir; }
+
+    // 1 if the direction is negative along the axis, else 0.
+    int sign(int axis) const { return dir_sign[axis]; }
+
     point3 at(double t) const {
         return orig + t*dir;
     }
@@ -37,6 +51,8 @@ class ray {
   private:
     point3 orig;
     vec3 dir;
+    vec3 inv_dir;
+    int dir_sign[3];
 };
 
 #endif
\ No newline at end of file
@@ -135,14 +135,19 @@ inline vec3 unit_vector(const vec3& v) {
     return v / v.length();
 }
 
+/*
+    The random direction and disk samplers below map uniform numbers straight onto the
+    target shape instead of rejecting points outside it, so every sample costs exactly two
+    random numbers and no loop.
+*/
+
+// Uniform on the unit sphere: z is uniform in [-1,1] (Archimedes' hat-box theorem) and the
+// azimuth is uniform in [0, 2pi).
 inline vec3 random_unit_vector() {
-    while (true) {
-        auto p = vec3::random(-1,1);
-        auto lensq = p.length_squared();
-        // stops underflow and make sure that vector falls within unit circule
-        if (1e-160 < lensq && lensq <= 1)
-            return p / sqrt(lensq);
-    }
+    auto z = 1 - 2*random_double();
+    auto r = std::sqrt(std::fmax(0.0, 1 - z*z));
+    auto phi = 2*pi*random_double();
+    return vec3(r*std::cos(phi), r*std::sin(phi), z);
 }
 
 inline vec3 random_on_hemisphere(const vec3& normal) {
@@ -177,12 +182,25 @@ inline vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat) {
     return r_out_perp + r_out_parallel;
 }
 
+// Uniform in the unit disk (z = 0); the square root on the radius keeps the density even.
 inline vec3 random_in_unit_disk() {
-    while (true) {
-        auto p = vec3(random_double(-1,1), random_double(-1,1), 0);
-        if (p.length_squared() < 1)
-            return p;
-    }
+    auto r = std::sqrt(random_double());
+    auto theta = 2*pi*random_double();
+    return vec3(r*std::cos(theta), r*std::sin(theta), 0);
+}
+
+// Cosine-weighted direction on the hemisphere around +z: a uniform disk sample projected up
+// onto the hemisphere (Malley's method).
+inline vec3 random_cosine_direction() {
+    auto r1 = random_double();
+    auto r2 = random_double();
+
+    auto phi = 2*pi*r1;
+    auto x = std::cos(phi) * std::sqrt(r2);
+    auto y = std::sin(phi) * std::sqrt(r2);
+    auto z = std::sqrt(1 - r2);
+
+    return vec3(x, y, z);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,88 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "objects/hittable.h"
+#include "objects/hittable_list.h"
+#include "utils/arena.h"
+
+#include <algorithm>
+
+/*
+    Bounding volume hierarchy. Each node owns the box around its two children, so a ray
+    that misses the box skips the whole subtree. The tree is split along the longest axis
+    of the node's bounding box at the median object, which keeps it balanced.
+
+    Given an arena, interior nodes are allocated from it next to the scene's primitives
+    rather than individually on the heap. They then only borrow their children, so the list's
+    objects must live in the same arena (or otherwise outlive the tree).
+*/
+
+class bvh_node : public hittable {
+  public:
+    bvh_node(hittable_list list, scene_arena* arena = nullptr)
+      : bvh_node(list.objects, 0, list.objects.size(), arena) {
+        // There's a C++ subtlety here. This constructor (without span indices) creates an
+        // implicit copy of the hittable list, which we will modify. The lifetime of the copied
+        // list only extends until this constructor exits. That's OK, because we only need to
+        // persist the resulting bounding volume hierarchy.
+    }
+
+    bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end,
+             scene_arena* arena = nullptr) {
+        // Build the bounding box of the span of source objects.
+        bbox = aabb::empty;
+        for (size_t object_index = start; object_index < end; object_index++)
+            bbox = aabb(bbox, objects[object_index]->bounding_box());
+
+        int axis = bbox.longest_axis();
+
+        size_t object_span = end - start;
+
+        if (object_span == 1) {
+            left = right = objects[start];
+        } else if (object_span == 2) {
+            left = objects[start];
+            right = objects[start+1];
+        } else {
+            auto comparator = [axis](const shared_ptr<hittable>& a, const shared_ptr<hittable>& b) {
+                return box_center(a->bounding_box(), axis) < box_center(b->bounding_box(), axis);
+            };
+
+            auto mid = start + object_span/2;
+            std::nth_element(objects.begin() + start, objects.begin() + mid, objects.begin() + end, comparator);
+
+            if (arena) {
+                left = borrow(arena->make_unmanaged<bvh_node>(objects, start, mid, arena));
+                right = borrow(arena->make_unmanaged<bvh_node>(objects, mid, end, arena));
+            } else {
+                left = make_shared<bvh_node>(objects, start, mid);
+                right = make_shared<bvh_node>(objects, mid, end);
+            }
+        }
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        thread_counters().box_tests++;
+        if (!bbox.hit(r, ray_t))
+            return false;
+
+        bool hit_left = left->hit(r, ray_t, rec);
+        bool hit_right = right->hit(r, interval(ray_t.min, hit_left ? rec.t : ray_t.max), rec);
+
+        return hit_left || hit_right;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+  private:
+    shared_ptr<hittable> left;
+    shared_ptr<hittable> right;
+    aabb bbox;
+
+    static double box_center(const aabb& box, int axis) {
+        const interval& ax = box.axis_interval(axis);
+        return 0.5 * (ax.min + ax.max);
+    }
+};
+
+#endif
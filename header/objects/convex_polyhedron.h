@@ -0,0 +1,186 @@
+#ifndef CONVEX_POLYHEDRON_H
+#define CONVEX_POLYHEDRON_H
+
+#include "hittable.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+/*
+    A convex solid is the intersection of its face half-spaces dot(n, p) <= d. Clipping a ray
+    against every half-space (Kay-Kajiya) gives the whole answer in one pass:
+
+        planes the ray enters through (dot(n, dir) < 0) push the entry distance up,
+        planes it leaves through      (dot(n, dir) > 0) pull the exit distance down,
+        planes it runs parallel to are either missed entirely or don't constrain it,
+
+    and the ray hits the solid iff entry <= exit. The entry face (or the exit face, for rays
+    starting inside, e.g. refracted rays in glass) gives the normal.
+
+    Planes are stored structure-of-arrays in single precision with unit normals, padded to a
+    multiple of four with planes that never clip, so four planes are loaded and tested at once
+    with AVX where available. As in compact_scene, the math is done in double after loading;
+    floats keep a tetrahedron at 112 bytes so large numbers of them can be instanced.
+*/
+
+template <int Faces>
+class convex_polyhedron : public hittable {
+  public:
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        thread_counters().primitive_tests++;
+
+        double t_enter, t_exit;
+        int enter_face, exit_face;
+        if (!clip(r, t_enter, enter_face, t_exit, exit_face))
+            return false;
+
+        double t;
+        int face;
+        if (ray_t.surrounds(t_enter)) {
+            t = t_enter;
+            face = enter_face;
+        } else if (ray_t.surrounds(t_exit)) {
+            t = t_exit;
+            face = exit_face;
+        } else {
+            return false;
+        }
+
+        rec.t = t;
+        rec.p = r.at(t);
+        rec.set_face_normal(r, vec3(nx[face], ny[face], nz[face]));
+        rec.mat = mat;
+        return true;
+    }
+
+    aabb bounding_box() const override {
+        return aabb(interval(lo[0], hi[0]), interval(lo[1], hi[1]), interval(lo[2], hi[2]));
+    }
+
+  protected:
+    static constexpr int padded_faces = (Faces + 3) / 4 * 4;
+
+    // Planes are filled in by the concrete shapes through set_plane().
+    convex_polyhedron(shared_ptr<material> mat) : mat(mat) {
+        for (int i = 0; i < padded_faces; i++) {
+            // 0.x <= 1 holds everywhere, so padding planes never clip a ray.
+            nx[i] = ny[i] = nz[i] = 0;
+            d[i] = 1;
+        }
+    }
+
+    // Face `i` passes through `point` with outward normal `normal` (need not be unit length).
+    void set_plane(int i, const vec3& normal, const point3& point) {
+        vec3 n = unit_vector(normal);
+        nx[i] = float(n.x());
+        ny[i] = float(n.y());
+        nz[i] = float(n.z());
+        d[i] = float(dot(n, point));
+    }
+
+    // Stores the bounds, widened slightly so that the rounding of the float planes can never
+    // put the surface outside them.
+    void set_bounds(const aabb& box) {
+        for (int a = 0; a < 3; a++) {
+            const interval& ax = box.axis_interval(a);
+            double margin = 1e-5 * ax.size() + 1e-6 * std::fmax(std::fabs(ax.min), std::fabs(ax.max));
+            lo[a] = std::nextafter(float(ax.min - margin), -std::numeric_limits<float>::infinity());
+            hi[a] = std::nextafter(float(ax.max + margin), std::numeric_limits<float>::infinity());
+        }
+    }
+
+  private:
+    float lo[3], hi[3];  // Ahead of the planes, filling the gap after the vtable pointer
+    alignas(16) float nx[padded_faces];
+    alignas(16) float ny[padded_faces];
+    alignas(16) float nz[padded_faces];
+    alignas(16) float d[padded_faces];
+    shared_ptr<material> mat;
+
+    // Entry and exit distances of the line through r, with the faces they lie on.
+    // Returns false if the line misses the solid.
+    bool clip(const ray& r, double& t_enter, int& enter_face, double& t_exit, int& exit_face) const {
+        const point3& o = r.origin();
+        const vec3& dir = r.direction();
+
+        alignas(32) double enter[padded_faces];  // Entry distance per plane, -inf if not entering
+        alignas(32) double exit[padded_faces];   // Exit distance per plane, +inf if not exiting
+        bool outside_parallel = false;           // Parallel to a plane and outside its half-space
+
+#if defined(__AVX__)
+        const __m256d ox = _mm256_set1_pd(o.x()), oy = _mm256_set1_pd(o.y()), oz = _mm256_set1_pd(o.z());
+        const __m256d dx = _mm256_set1_pd(dir.x()), dy = _mm256_set1_pd(dir.y()), dz = _mm256_set1_pd(dir.z());
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d pos_inf = _mm256_set1_pd(infinity), neg_inf = _mm256_set1_pd(-infinity);
+
+        for (int i = 0; i < padded_faces; i += 4) {
+            __m256d pnx = _mm256_cvtps_pd(_mm_load_ps(nx + i));
+            __m256d pny = _mm256_cvtps_pd(_mm_load_ps(ny + i));
+            __m256d pnz = _mm256_cvtps_pd(_mm_load_ps(nz + i));
+
+            __m256d denom = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(pnx, dx), _mm256_mul_pd(pny, dy)),
+                                          _mm256_mul_pd(pnz, dz));
+            __m256d dist  = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(pnx, ox), _mm256_mul_pd(pny, oy)),
+                                          _mm256_mul_pd(pnz, oz));
+            __m256d num   = _mm256_sub_pd(_mm256_cvtps_pd(_mm_load_ps(d + i)), dist);
+            __m256d t     = _mm256_div_pd(num, denom);
+
+            __m256d entering = _mm256_cmp_pd(denom, zero, _CMP_LT_OQ);
+            __m256d exiting  = _mm256_cmp_pd(denom, zero, _CMP_GT_OQ);
+            _mm256_store_pd(enter + i, _mm256_blendv_pd(neg_inf, t, entering));
+            _mm256_store_pd(exit + i,  _mm256_blendv_pd(pos_inf, t, exiting));
+
+            __m256d parallel = _mm256_cmp_pd(denom, zero, _CMP_EQ_OQ);
+            __m256d outside  = _mm256_and_pd(parallel, _mm256_cmp_pd(num, zero, _CMP_LT_OQ));
+            outside_parallel |= _mm256_movemask_pd(outside) != 0;
+        }
+#else
+        for (int i = 0; i < padded_faces; i++) {
+            double pnx = nx[i], pny = ny[i], pnz = nz[i];
+            double denom = pnx*dir.x() + pny*dir.y() + pnz*dir.z();
+            double num = double(d[i]) - (pnx*o.x() + pny*o.y() + pnz*o.z());
+            double t = num / denom;
+
+            enter[i] = denom < 0 ? t : -infinity;
+            exit[i]  = denom > 0 ? t : infinity;
+            outside_parallel |= (denom == 0) & (num < 0);
+        }
+#endif
+
+        if (outside_parallel)
+            return false;
+
+        t_enter = -infinity;
+        t_exit = infinity;
+        enter_face = exit_face = 0;
+        for (int i = 0; i < padded_faces; i++) {
+            if (enter[i] > t_enter) { t_enter = enter[i]; enter_face = i; }
+            if (exit[i]  < t_exit)  { t_exit  = exit[i];  exit_face  = i; }
+        }
+
+        return t_enter <= t_exit;
+    }
+};
+
+// A box with arbitrary orientation: center, three orthogonal axes and the half-extent along each.
+class oriented_box : public convex_polyhedron<6> {
+  public:
+    oriented_box(const point3& center, const vec3& axis_u, const vec3& axis_v, const vec3& axis_w,
+                 const vec3& half_extents, shared_ptr<material> mat)
+      : convex_polyhedron<6>(mat)
+    {
+        const vec3 axes[3] = { unit_vector(axis_u), unit_vector(axis_v), unit_vector(axis_w) };
+
+        vec3 reach(0,0,0);  // Half-size of the axis-aligned box around the rotated box
+        for (int a = 0; a < 3; a++) {
+            vec3 offset = half_extents[a] * axes[a];
+            set_plane(2*a,      axes[a], center + offset);
+            set_plane(2*a + 1, -axes[a], center - offset);
+            reach += vec3(std::fabs(offset.x()), std::fabs(offset.y()), std::fabs(offset.z()));
+        }
+        set_bounds(aabb(center - reach, center + reach));
+    }
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define HITTABLE_H
 
 #include "utils/rtweekend.h"  // Includes vec3, ray, and utility functions
+#include "core/aabb.h"
 
 class material;
 
@@ -24,6 +25,8 @@ public:
     virtual ~hittable() = default;
 
     virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0; // Use 'interval ray_t' here
+
+    virtual aabb bounding_box() const = 0;
 };
 
 #endif
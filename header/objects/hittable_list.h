@@ -2,6 +2,7 @@
 #define HITTABLE_LIST_H
 
 #include "utils/rtweekend.h"   // For shared_ptr, ray, and utilities
+#include "objects/hittable.h"
 
 #include <vector>
 
@@ -13,10 +14,11 @@ class hittable_list : public hittable {
     hittable_list() {}
     hittable_list(shared_ptr<hittable> object) { add(object); }
 
-    void clear() { objects.clear(); }
+    void clear() { objects.clear(); bbox = aabb(); }
 
     void add(shared_ptr<hittable> object) {
         objects.push_back(object);
+        bbox = aabb(bbox, object->bounding_box());
     }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
@@ -34,6 +36,11 @@ class hittable_list : public hittable {
 
         return hit_anything;
     }
+
+    aabb bounding_box() const override { return bbox; }
+
+  private:
+    aabb bbox;
 };
 
 #endif
\ No newline at end of file
@@ -5,9 +5,14 @@
 
 class sphere : public hittable {
   public:
-    sphere(const point3& center, double radius, shared_ptr<material> mat) : center(center), radius(std::fmax(0, radius)), mat(mat) {}
+    sphere(const point3& center, double radius, shared_ptr<material> mat) : center(center), radius(std::fmax(0, radius)), mat(mat) {
+        auto rvec = vec3(radius, radius, radius);
+        bbox = aabb(center - rvec, center + rvec);
+    }
 
     bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        thread_counters().primitive_tests++;
+
         vec3 oc = center - r.origin();
         auto a = r.direction().length_squared();
         auto h = dot(r.direction(), oc);
@@ -36,10 +41,13 @@ class sphere : public hittable {
         return true;
     }
 
+    aabb bounding_box() const override { return bbox; }
+
   private:
     point3 center;
     double radius;
     shared_ptr<material> mat;
+    aabb bbox;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,712 @@
+#ifndef CHUNKED_SCENE_H
+#define CHUNKED_SCENE_H
+
+#include "scene/compact_scene.h"
+#include "utils/thread_pool.h"
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+    Out-of-core compact geometry. write() splits a compact_scene spatially into chunks and
+    stores each, with its own BVH, in a file laid out exactly like compact_view's arrays;
+    a writer does the same for primitives streamed in batches, never holding them all. A
+    chunked_scene then keeps only a small BVH over the chunk bounds in memory, and the chunks
+    rays reach through it are memory-mapped on demand through a cache bounded in bytes, so
+    geometry far larger than RAM can be traced with a fixed resident set.
+
+    Finding a resident chunk takes no lock: the ray pins the chunk's slot with an atomic
+    count and reads its mapping. Only a miss takes the cache mutex, and the file is mapped
+    outside it. Eviction is least recently used by miss epoch, and a chunk evicted while
+    pinned is unmapped once its last reader lets go.
+
+    Files are native-endian and only meant to be read back on the machine that wrote them.
+    The material palette is not stored; the caller supplies it when opening.
+
+        <dir>/chunks.idx     index_header, then one index_entry per chunk
+        <dir>/chunk_N.bin    chunk_header, then spheres, cubes, tetrahedra, refs and nodes
+*/
+
+class chunked_scene : public hittable {
+  public:
+    // Cache counters. Bytes paged in counts whole chunk files as they are mapped.
+    struct cache_stats {
+        size_t hits           = 0;
+        size_t misses         = 0;
+        size_t evictions      = 0;
+        size_t bytes_paged_in = 0;
+
+        double hit_rate() const { return hits + misses ? double(hits) / (hits + misses) : 0; }
+    };
+
+    // Splits the source into chunks of at most chunk_primitives and writes them to dir, which
+    // must exist. Returns false if a file could not be written.
+    static bool write(const compact_scene& source, const std::string& dir, size_t chunk_primitives,
+                      thread_pool* pool = nullptr) {
+        TRACE_SCOPE("write chunks");
+        std::vector<index_entry> entries;
+        return append_chunks(source, dir, chunk_primitives, pool, entries)
+            && write_index(dir, entries, source.materials.size());
+    }
+
+    /*
+        Writes chunks from primitives added a batch at a time, holding only a bounded buffer
+        in memory. Primitives are binned by center on a grid of columns over the x-z extent
+        given up front (those outside fall in the edge columns); full column buffers are
+        spilled to a temporary file in dir. finish() then loads one column at a time and
+        splits it into chunks as write() would. Columns are sized for about one chunk each;
+        clustering can pack several chunks' worth into one, and that column must fit in memory.
+    */
+    class writer {
+      public:
+        writer(const std::string& dir, size_t chunk_primitives, size_t expected_primitives,
+               double x_min, double x_max, double z_min, double z_max, thread_pool* pool = nullptr)
+          : dir(dir), chunk_primitives(std::max<size_t>(chunk_primitives, 1)), pool(pool),
+            x_min(x_min), z_min(z_min)
+        {
+            auto chunks = std::max<size_t>(1, expected_primitives / this->chunk_primitives);
+            side = std::max<size_t>(1, size_t(std::ceil(std::sqrt(double(chunks)))));
+            x_scale = side / std::max(x_max - x_min, 1e-9);
+            z_scale = side / std::max(z_max - z_min, 1e-9);
+            columns.resize(side * side);
+            spill_limit = std::max<size_t>(64, buffered_primitives / columns.size());
+        }
+
+        void add(const compact_scene& batch) {
+            for (const auto& s : batch.spheres)
+                push(s, &column::spheres);
+            for (const auto& b : batch.cubes)
+                push(b, &column::cubes);
+            for (const auto& t : batch.tetrahedra)
+                push(t, &column::tetrahedra);
+        }
+
+        // Writes the chunk files and the index. Returns false if a file could not be written.
+        bool finish(size_t material_count) {
+            TRACE_SCOPE("write chunks");
+            std::vector<index_entry> entries;
+            for (size_t c = 0; c < columns.size() && ok; c++) {
+                compact_scene source;
+                ok = load(c, source) && append_chunks(source, dir, chunk_primitives, pool, entries);
+            }
+            return ok && write_index(dir, entries, material_count);
+        }
+
+      private:
+        // Primitives buffered in memory across all columns before they are spilled.
+        static constexpr size_t buffered_primitives = size_t(1) << 20;
+
+        struct column {
+            std::vector<compact_sphere>       spheres;
+            std::vector<compact_cube>         cubes;
+            std::vector<compact_tetrahedron>  tetrahedra;
+            bool                              spilled = false;
+
+            size_t size() const { return spheres.size() + cubes.size() + tetrahedra.size(); }
+        };
+
+        std::string          dir;
+        size_t               chunk_primitives;
+        thread_pool*         pool;
+        double               x_min, z_min, x_scale, z_scale;
+        size_t               side;          // Columns along each axis
+        size_t               spill_limit;   // Buffered primitives per column
+        std::vector<column>  columns;
+        bool                 ok = true;
+
+        std::string spill_path(size_t c) const { return dir + "/column_" + std::to_string(c) + ".tmp"; }
+
+        size_t column_of(const float center[3]) const {
+            auto cell = [this](double v, double lo, double scale) {
+                return size_t(std::clamp((v - lo) * scale, 0.0, double(side - 1)));
+            };
+            return cell(center[2], z_min, z_scale) * side + cell(center[0], x_min, x_scale);
+        }
+
+        template <typename T>
+        void push(const T& primitive, std::vector<T> column::* array) {
+            auto c = column_of(primitive.center);
+            (columns[c].*array).push_back(primitive);
+            if (columns[c].size() >= spill_limit)
+                spill(c);
+        }
+
+        // Appends the column's buffer to its spill file as one block: the three counts, then
+        // the three arrays.
+        void spill(size_t c) {
+            auto& col = columns[c];
+            std::ofstream out(spill_path(c), std::ios::binary | (col.spilled ? std::ios::app : std::ios::trunc));
+            uint64_t counts[3] = { col.spheres.size(), col.cubes.size(), col.tetrahedra.size() };
+            out.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+            out.write(reinterpret_cast<const char*>(col.spheres.data()), std::streamsize(counts[0] * sizeof(compact_sphere)));
+            out.write(reinterpret_cast<const char*>(col.cubes.data()), std::streamsize(counts[1] * sizeof(compact_cube)));
+            out.write(reinterpret_cast<const char*>(col.tetrahedra.data()),
+                      std::streamsize(counts[2] * sizeof(compact_tetrahedron)));
+            if (!out && ok) {
+                std::clog << "Could not write " << spill_path(c) << '\n';
+                ok = false;
+            }
+            col.spilled = true;
+            col.spheres.clear();
+            col.cubes.clear();
+            col.tetrahedra.clear();
+        }
+
+        // Moves column c, spilled blocks first, into source and deletes its spill file.
+        bool load(size_t c, compact_scene& source) {
+            auto& col = columns[c];
+            if (col.spilled) {
+                std::ifstream in(spill_path(c), std::ios::binary);
+                uint64_t counts[3];
+                while (in.read(reinterpret_cast<char*>(counts), sizeof(counts))) {
+                    if (!read_block(in, source.spheres, counts[0]) || !read_block(in, source.cubes, counts[1])
+                        || !read_block(in, source.tetrahedra, counts[2])) {
+                        std::clog << spill_path(c) << " is truncated\n";
+                        return false;
+                    }
+                }
+                in.close();
+                std::remove(spill_path(c).c_str());
+            }
+            source.spheres.insert(source.spheres.end(), col.spheres.begin(), col.spheres.end());
+            source.cubes.insert(source.cubes.end(), col.cubes.begin(), col.cubes.end());
+            source.tetrahedra.insert(source.tetrahedra.end(), col.tetrahedra.begin(), col.tetrahedra.end());
+            col = column();
+            return true;
+        }
+
+        template <typename T>
+        static bool read_block(std::ifstream& in, std::vector<T>& array, uint64_t count) {
+            auto start = array.size();
+            array.resize(start + count);
+            return bool(in.read(reinterpret_cast<char*>(array.data() + start), std::streamsize(count * sizeof(T))));
+        }
+    };
+
+    // Opens the chunks in dir. Keeps at most cache_bytes of chunk files mapped at once, except
+    // that chunks in use by a ray stay mapped until it is done with them.
+    bool open(const std::string& dir, std::vector<shared_ptr<material>> palette, size_t cache_bytes) {
+        std::ifstream in(dir + "/chunks.idx", std::ios::binary);
+        index_header header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || std::memcmp(header.magic, index_magic, sizeof(header.magic)) != 0) {
+            std::clog << dir << "/chunks.idx is missing or not a chunk index\n";
+            return false;
+        }
+        if (header.material_count != palette.size()) {
+            std::clog << "Chunks in " << dir << " use " << header.material_count
+                      << " materials, but the palette has " << palette.size() << '\n';
+            return false;
+        }
+
+        std::vector<index_entry> entries(header.chunk_count);
+        if (!in.read(reinterpret_cast<char*>(entries.data()), std::streamsize(entries.size() * sizeof(index_entry)))) {
+            std::clog << dir << "/chunks.idx is truncated\n";
+            return false;
+        }
+
+        directory = dir;
+        materials = std::move(palette);
+        capacity = cache_bytes;
+        chunks = std::vector<chunk_slot>(entries.size());
+        resident.clear();
+        retired.clear();
+        resident_bytes = 0;
+        counters = cache_stats();
+
+        // One chunk per leaf, so a leaf's box is its chunk's bounds.
+        top_refs.resize(entries.size());
+        std::iota(top_refs.begin(), top_refs.end(), 0);
+        top_nodes.clear();
+        bbox = aabb::empty;
+        if (!entries.empty()) {
+            top_nodes.reserve(2 * entries.size() - 1);
+            top_nodes.emplace_back();
+            build_top(entries, 0, 0, entries.size());
+
+            const auto& root = top_nodes[0];
+            bbox = aabb(interval(root.lo[0], root.hi[0]), interval(root.lo[1], root.hi[1]),
+                        interval(root.lo[2], root.hi[2]));
+        }
+        return true;
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        if (top_nodes.empty())
+            return false;
+
+        thread_counters().box_tests++;
+        double t_root;
+        if (!slab_hit(r, top_nodes[0].lo, top_nodes[0].hi, ray_t, t_root))
+            return false;
+
+        // As compact_view::hit, nearer child first, so a hit in one chunk prunes those behind it.
+        bool hit_anything = false;
+        uint32_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            const compact_node& n = top_nodes[stack[--top]];
+
+            if (n.count > 0) {
+                for (uint32_t k = n.offset; k < n.offset + n.count; k++) {
+                    if (hit_chunk(top_refs[k], r, ray_t, rec)) {
+                        hit_anything = true;
+                        ray_t.max = rec.t;
+                    }
+                }
+                continue;
+            }
+
+            thread_counters().box_tests += 2;
+            double t_left, t_right;
+            bool hit_left  = slab_hit(r, top_nodes[n.offset].lo,     top_nodes[n.offset].hi,     ray_t, t_left);
+            bool hit_right = slab_hit(r, top_nodes[n.offset + 1].lo, top_nodes[n.offset + 1].hi, ray_t, t_right);
+
+            if (hit_left && hit_right) {
+                bool left_first = t_left <= t_right;
+                stack[top++] = n.offset + (left_first ? 1 : 0);
+                stack[top++] = n.offset + (left_first ? 0 : 1);
+            } else if (hit_left) {
+                stack[top++] = n.offset;
+            } else if (hit_right) {
+                stack[top++] = n.offset + 1;
+            }
+        }
+
+        return hit_anything;
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+    size_t chunk_count() const { return chunks.size(); }
+
+    cache_stats stats() const {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        cache_stats s = counters;
+        for (const auto& slot : chunks)
+            s.hits += slot.hits.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void report(std::ostream& out) const {
+        auto s = stats();
+        out << "Chunk cache: " << chunks.size() << " chunks, " << 100.0 * s.hit_rate() << "% hit rate ("
+            << s.hits << " hits, " << s.misses << " misses, " << s.evictions << " evictions), "
+            << s.bytes_paged_in / (1024.0 * 1024.0) << " MiB paged in\n";
+    }
+
+  private:
+    static constexpr char index_magic[8] = { 'R','T','C','H','I','D','X','1' };
+    static constexpr char chunk_magic[8] = { 'R','T','C','H','U','N','K','1' };
+
+    struct index_header {
+        char     magic[8];
+        uint64_t chunk_count = 0;
+        uint64_t material_count = 0;
+
+        index_header() { std::memcpy(magic, index_magic, sizeof(magic)); }
+    };
+
+    struct index_entry {
+        float    lo[3], hi[3];
+        uint64_t primitives = 0;
+        uint64_t file_bytes = 0;
+    };
+
+    // Counts and byte offsets of the arrays that follow it in a chunk file.
+    struct chunk_header {
+        char     magic[8];
+        uint64_t sphere_count, cube_count, tetrahedron_count, ref_count, node_count;
+        uint64_t sphere_offset, cube_offset, tetrahedron_offset, ref_offset, node_offset;
+    };
+
+    // A mapped chunk file, unmapped when destroyed.
+    struct mapped_chunk {
+        void*        address = nullptr;
+        size_t       bytes = 0;
+        compact_view view{};
+
+        ~mapped_chunk() {
+            if (address)
+                munmap(address, bytes);
+        }
+    };
+
+    // Per-chunk cache state. Rays only touch the atomics; the rest is guarded by cache_mutex.
+    // A cache line each, so rays pinning neighbouring chunks don't contend.
+    struct alignas(64) chunk_slot {
+        std::atomic<const mapped_chunk*>  mapped{nullptr};  // Null when not resident
+        std::atomic<uint32_t>             readers{0};       // Rays pinning this slot
+        std::atomic<uint64_t>             last_used{0};     // Miss epoch of the latest visit
+        std::atomic<size_t>               hits{0};
+        std::unique_ptr<mapped_chunk>     owned;            // Backs mapped while resident
+        bool                              loading = false;  // Being mapped by some thread
+    };
+
+    struct part_ref {
+        float    center[3];
+        uint32_t ref;
+
+        part_ref(const float c[3], uint32_t type, uint32_t index)
+          : center{ c[0], c[1], c[2] }, ref(compact_view::make_ref(type, index)) {}
+    };
+
+    std::string                          directory;
+    std::vector<shared_ptr<material>>    materials;
+    std::vector<compact_node>            top_nodes;   // BVH over the chunk bounds
+    std::vector<uint32_t>                top_refs;    // Chunk indices, in leaf order
+    mutable std::vector<chunk_slot>      chunks;
+    mutable std::vector<uint32_t>        resident;    // Chunks currently mapped
+    mutable std::vector<std::pair<uint32_t, std::unique_ptr<mapped_chunk>>> retired;  // Evicted, still pinned
+    mutable size_t                       resident_bytes = 0;
+    mutable cache_stats                  counters;    // All but hits, which the slots count
+    mutable std::atomic<uint64_t>        epoch{0};    // Bumped on every miss
+    mutable std::mutex                   cache_mutex;
+    mutable std::condition_variable      chunk_loaded;
+    mutable std::atomic<bool>            reported_failure{false};
+    size_t                               capacity = 0;
+    aabb                                 bbox;
+
+    static std::string chunk_path(const std::string& dir, size_t index) {
+        return dir + "/chunk_" + std::to_string(index) + ".bin";
+    }
+
+    static void partition(std::vector<part_ref>& parts, size_t begin, size_t end, size_t limit,
+                          std::vector<std::pair<size_t, size_t>>& ranges) {
+        if (end - begin <= limit) {
+            if (end > begin)
+                ranges.push_back({ begin, end });
+            return;
+        }
+
+        float lo[3] = { parts[begin].center[0], parts[begin].center[1], parts[begin].center[2] };
+        float hi[3] = { lo[0], lo[1], lo[2] };
+        for (size_t k = begin; k < end; k++) {
+            for (int a = 0; a < 3; a++) {
+                lo[a] = std::min(lo[a], parts[k].center[a]);
+                hi[a] = std::max(hi[a], parts[k].center[a]);
+            }
+        }
+        int axis = 0;
+        for (int a = 1; a < 3; a++) {
+            if (hi[a] - lo[a] > hi[axis] - lo[axis])
+                axis = a;
+        }
+
+        auto mid = begin + (end - begin) / 2;
+        std::nth_element(parts.begin() + begin, parts.begin() + mid, parts.begin() + end,
+            [axis](const part_ref& a, const part_ref& b) { return a.center[axis] < b.center[axis]; });
+        partition(parts, begin, mid, limit, ranges);
+        partition(parts, mid, end, limit, ranges);
+    }
+
+    // Splits source into chunks of at most chunk_primitives, writes them to dir numbered on
+    // from entries.size(), and appends their index entries.
+    static bool append_chunks(const compact_scene& source, const std::string& dir, size_t chunk_primitives,
+                              thread_pool* pool, std::vector<index_entry>& entries) {
+        // Split on primitive centers, median first along the widest axis, as the BVH does.
+        std::vector<part_ref> parts;
+        parts.reserve(source.primitive_count());
+        for (uint32_t i = 0; i < source.spheres.size(); i++)
+            parts.push_back(part_ref(source.spheres[i].center, compact_view::sphere_type, i));
+        for (uint32_t i = 0; i < source.cubes.size(); i++)
+            parts.push_back(part_ref(source.cubes[i].center, compact_view::cube_type, i));
+        for (uint32_t i = 0; i < source.tetrahedra.size(); i++)
+            parts.push_back(part_ref(source.tetrahedra[i].center, compact_view::tetrahedron_type, i));
+
+        std::vector<std::pair<size_t, size_t>> ranges;
+        partition(parts, 0, parts.size(), std::max<size_t>(chunk_primitives, 1), ranges);
+
+        for (size_t c = 0; c < ranges.size(); c++) {
+            compact_scene chunk;
+            for (size_t k = ranges[c].first; k < ranges[c].second; k++) {
+                auto index = compact_view::ref_index(parts[k].ref);
+                switch (compact_view::ref_type(parts[k].ref)) {
+                    case compact_view::sphere_type: chunk.spheres.push_back(source.spheres[index]); break;
+                    case compact_view::cube_type:   chunk.cubes.push_back(source.cubes[index]); break;
+                    default:                        chunk.tetrahedra.push_back(source.tetrahedra[index]); break;
+                }
+            }
+            chunk.build_acceleration(pool);
+
+            index_entry entry;
+            auto box = chunk.bounding_box();
+            for (int a = 0; a < 3; a++) {
+                entry.lo[a] = float(box.axis_interval(a).min);
+                entry.hi[a] = float(box.axis_interval(a).max);
+            }
+            entry.primitives = chunk.primitive_count();
+            if (!write_chunk(chunk.view(), chunk_path(dir, entries.size()), entry.file_bytes))
+                return false;
+            entries.push_back(entry);
+        }
+
+        return true;
+    }
+
+    static bool write_index(const std::string& dir, const std::vector<index_entry>& entries, size_t material_count) {
+        std::ofstream out(dir + "/chunks.idx", std::ios::binary);
+        index_header header;
+        header.chunk_count = entries.size();
+        header.material_count = material_count;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(entries.size() * sizeof(index_entry)));
+        if (!out) {
+            std::clog << "Could not write " << dir << "/chunks.idx\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Builds top node node_index over top_refs[begin, end), splitting at the median chunk
+    // center along the widest axis.
+    void build_top(const std::vector<index_entry>& entries, uint32_t node_index, size_t begin, size_t end) {
+        float lo[3], hi[3], center_lo[3], center_hi[3];
+        for (int a = 0; a < 3; a++) {
+            lo[a] = center_lo[a] = std::numeric_limits<float>::infinity();
+            hi[a] = center_hi[a] = -std::numeric_limits<float>::infinity();
+        }
+        for (size_t k = begin; k < end; k++) {
+            const auto& e = entries[top_refs[k]];
+            for (int a = 0; a < 3; a++) {
+                lo[a] = std::min(lo[a], e.lo[a]);
+                hi[a] = std::max(hi[a], e.hi[a]);
+                center_lo[a] = std::min(center_lo[a], e.lo[a] + e.hi[a]);
+                center_hi[a] = std::max(center_hi[a], e.lo[a] + e.hi[a]);
+            }
+        }
+        auto& n = top_nodes[node_index];
+        std::copy(lo, lo + 3, n.lo);
+        std::copy(hi, hi + 3, n.hi);
+
+        if (end - begin == 1) {
+            n.offset = uint32_t(begin);
+            n.count = 1;
+            return;
+        }
+
+        int axis = 0;
+        for (int a = 1; a < 3; a++) {
+            if (center_hi[a] - center_lo[a] > center_hi[axis] - center_lo[axis])
+                axis = a;
+        }
+        auto mid = begin + (end - begin) / 2;
+        std::nth_element(top_refs.begin() + begin, top_refs.begin() + mid, top_refs.begin() + end,
+            [&entries, axis](uint32_t a, uint32_t b) {
+                return entries[a].lo[axis] + entries[a].hi[axis] < entries[b].lo[axis] + entries[b].hi[axis];
+            });
+
+        // Children go adjacent at the end; reserve() in open() keeps n valid until here.
+        auto left = uint32_t(top_nodes.size());
+        n.offset = left;
+        n.count = 0;
+        top_nodes.emplace_back();
+        top_nodes.emplace_back();
+        build_top(entries, left, begin, mid);
+        build_top(entries, left + 1, mid, end);
+    }
+
+    static size_t align_up(size_t offset) { return (offset + 15) & ~size_t(15); }
+
+    static bool write_chunk(const compact_view& view, const std::string& path, uint64_t& file_bytes) {
+        // The view's primitive counts aren't stored in it; recover them from the refs.
+        uint64_t counts[3] = { 0, 0, 0 };
+        for (size_t k = 0; k < view.ref_count; k++)
+            counts[compact_view::ref_type(view.refs[k])]++;
+
+        chunk_header header;
+        std::memcpy(header.magic, chunk_magic, sizeof(header.magic));
+        header.sphere_count      = counts[compact_view::sphere_type];
+        header.cube_count        = counts[compact_view::cube_type];
+        header.tetrahedron_count = counts[compact_view::tetrahedron_type];
+        header.ref_count         = view.ref_count;
+        header.node_count        = view.node_count;
+
+        const void* arrays[5] = { view.spheres, view.cubes, view.tetrahedra, view.refs, view.nodes };
+        size_t sizes[5] = {
+            header.sphere_count * sizeof(compact_sphere),
+            header.cube_count * sizeof(compact_cube),
+            header.tetrahedron_count * sizeof(compact_tetrahedron),
+            header.ref_count * sizeof(uint32_t),
+            header.node_count * sizeof(compact_node),
+        };
+        uint64_t* offsets[5] = { &header.sphere_offset, &header.cube_offset, &header.tetrahedron_offset,
+                                 &header.ref_offset, &header.node_offset };
+
+        size_t offset = align_up(sizeof(header));
+        for (int i = 0; i < 5; i++) {
+            *offsets[i] = offset;
+            offset = align_up(offset + sizes[i]);
+        }
+        file_bytes = offset;
+
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        static const char padding[16] = {};
+        size_t written = sizeof(header);
+        for (int i = 0; i < 5; i++) {
+            out.write(padding, std::streamsize(*offsets[i] - written));
+            out.write(static_cast<const char*>(arrays[i]), std::streamsize(sizes[i]));
+            written = *offsets[i] + sizes[i];
+        }
+        out.write(padding, std::streamsize(file_bytes - written));
+
+        if (!out) {
+            std::clog << "Could not write " << path << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    std::unique_ptr<mapped_chunk> map_chunk(uint32_t index) const {
+        auto path = chunk_path(directory, index);
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+
+        struct stat info;
+        void* address = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(chunk_header))
+            address = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED)
+            return nullptr;
+
+        auto chunk = std::make_unique<mapped_chunk>();
+        chunk->address = address;
+        chunk->bytes = size_t(info.st_size);
+
+        const auto* base = static_cast<const char*>(address);
+        chunk_header header;
+        std::memcpy(&header, base, sizeof(header));
+        if (std::memcmp(header.magic, chunk_magic, sizeof(header.magic)) != 0
+            || header.node_offset + header.node_count * sizeof(compact_node) > chunk->bytes)
+            return nullptr;
+
+        chunk->view = {
+            materials.data(),
+            reinterpret_cast<const compact_sphere*>(base + header.sphere_offset),
+            reinterpret_cast<const compact_cube*>(base + header.cube_offset),
+            reinterpret_cast<const compact_tetrahedron*>(base + header.tetrahedron_offset),
+            reinterpret_cast<const uint32_t*>(base + header.ref_offset), header.ref_count,
+            reinterpret_cast<const compact_node*>(base + header.node_offset), header.node_count,
+        };
+        return chunk;
+    }
+
+    // Traces r through chunk index, mapping the chunk first if it isn't resident.
+    bool hit_chunk(uint32_t index, const ray& r, const interval& ray_t, hit_record& rec) const {
+        auto& slot = chunks[index];
+        bool first_try = true;
+
+        for (;;) {
+            // Pinning before reading the mapping keeps it mapped while we trace: eviction
+            // unpublishes the mapping first and only then looks for readers.
+            slot.readers.fetch_add(1);
+            if (const mapped_chunk* chunk = slot.mapped.load()) {
+                if (first_try)
+                    slot.hits.fetch_add(1, std::memory_order_relaxed);
+                auto now = epoch.load(std::memory_order_relaxed);
+                if (slot.last_used.load(std::memory_order_relaxed) != now)
+                    slot.last_used.store(now, std::memory_order_relaxed);
+
+                bool hit = chunk->view.hit(r, ray_t, rec);
+                slot.readers.fetch_sub(1);
+                return hit;
+            }
+            slot.readers.fetch_sub(1);
+
+            if (!page_in(index))
+                return false;
+            first_try = false;
+        }
+    }
+
+    // Makes the chunk resident, evicting least recently used chunks to stay within capacity.
+    // Returns false if the file can't be mapped.
+    bool page_in(uint32_t index) const {
+        auto& slot = chunks[index];
+        std::unique_lock<std::mutex> lock(cache_mutex);
+        chunk_loaded.wait(lock, [&slot] { return !slot.loading; });
+        if (slot.owned)
+            return true;
+
+        counters.misses++;
+        slot.loading = true;
+        lock.unlock();
+        auto chunk = map_chunk(index);
+        lock.lock();
+        slot.loading = false;
+        chunk_loaded.notify_all();
+
+        if (!chunk) {
+            if (!reported_failure.exchange(true))
+                std::clog << "Could not map " << chunk_path(directory, index) << '\n';
+            return false;
+        }
+
+        release_retired();
+        while (!resident.empty() && resident_bytes + chunk->bytes > capacity)
+            evict_oldest();
+
+        counters.bytes_paged_in += chunk->bytes;
+        resident_bytes += chunk->bytes;
+        resident.push_back(index);
+        slot.last_used.store(epoch.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        slot.mapped.store(chunk.get());
+        slot.owned = std::move(chunk);
+        return true;
+    }
+
+    // Evicts the resident chunk used longest ago. Called with cache_mutex held.
+    void evict_oldest() const {
+        size_t oldest = 0;
+        for (size_t k = 1; k < resident.size(); k++) {
+            if (chunks[resident[k]].last_used.load(std::memory_order_relaxed)
+                < chunks[resident[oldest]].last_used.load(std::memory_order_relaxed))
+                oldest = k;
+        }
+        uint32_t index = resident[oldest];
+        resident[oldest] = resident.back();
+        resident.pop_back();
+
+        auto& slot = chunks[index];
+        slot.mapped.store(nullptr);
+        resident_bytes -= slot.owned->bytes;
+        counters.evictions++;
+        if (slot.readers.load() == 0)
+            slot.owned.reset();
+        else
+            retired.push_back({ index, std::move(slot.owned) });
+    }
+
+    // Unmaps evicted chunks that no ray has pinned since. Called with cache_mutex held.
+    void release_retired() const {
+        retired.erase(std::remove_if(retired.begin(), retired.end(),
+                          [this](const auto& entry) { return chunks[entry.first].readers.load() == 0; }),
+                      retired.end());
+    }
+};
+
+#endif
@@ -0,0 +1,384 @@
+#ifndef COMPACT_SCENE_H
+#define COMPACT_SCENE_H
+
+#include "objects/hittable.h"
+#include "utils/arena.h"
+#include "utils/thread_pool.h"
+#include "utils/trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/*
+    Scene storage for very large numbers of simple primitives. Instead of one heap-allocated
+    hittable per object, spheres, axis-aligned cubes and tetrahedra live in flat per-type
+    arrays of small float records that point into a shared material palette by index, and one
+    flat BVH (nodes in a single array, children adjacent) is built over all of them.
+
+    Geometry is stored in single precision to halve its footprint; intersection math is done
+    in double after loading, exactly as the individual primitive classes do it.
+*/
+
+struct compact_sphere {
+    float    center[3];
+    float    radius;
+    uint32_t material;
+};
+
+struct compact_cube {
+    float    center[3];
+    float    half_side;
+    uint32_t material;
+};
+
+// Face planes dot(n, p) <= d with unit normals, as in convex_polyhedron, plus a bounding sphere.
+struct compact_tetrahedron {
+    float    plane[4][4];  // nx, ny, nz, d
+    float    center[3];
+    float    radius;
+    uint32_t material;
+};
+
+// BVH node. Leaf when count > 0 (refs[offset .. offset+count)), else children at offset
+// and offset+1.
+struct compact_node {
+    float    lo[3];
+    uint32_t offset = 0;
+    float    hi[3];
+    uint32_t count = 0;
+};
+
+// Read-only view of compact primitives and the BVH over them, wherever the arrays live: in a
+// compact_scene's vectors or in a memory-mapped chunk file (see chunked_scene.h).
+struct compact_view {
+    const shared_ptr<material>*  materials;
+    const compact_sphere*        spheres;
+    const compact_cube*          cubes;
+    const compact_tetrahedron*   tetrahedra;
+    const uint32_t*              refs;       // Primitive type in the top two bits, index in the rest
+    size_t                       ref_count;
+    const compact_node*          nodes;
+    size_t                       node_count;
+
+    static constexpr uint32_t sphere_type      = 0;
+    static constexpr uint32_t cube_type        = 1;
+    static constexpr uint32_t tetrahedron_type = 2;
+
+    static constexpr uint32_t max_index        = 0x3FFFFFFF;   // Index bits below the type
+
+    static uint32_t make_ref(uint32_t type, uint32_t index) { return (type << 30) | index; }
+    static uint32_t ref_type(uint32_t ref)  { return ref >> 30; }
+    static uint32_t ref_index(uint32_t ref) { return ref & max_index; }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const {
+        if (ref_count == 0)
+            return false;
+
+        bool hit_anything = false;
+        uint32_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0) {
+            const node& n = nodes[stack[--top]];
+
+            if (n.count > 0) {
+                for (uint32_t k = n.offset; k < n.offset + n.count; k++) {
+                    if (hit_primitive(refs[k], r, ray_t, rec)) {
+                        hit_anything = true;
+                        ray_t.max = rec.t;
+                    }
+                }
+                continue;
+            }
+
+            // Visit the nearer child first so that its hits can prune the farther one.
+            thread_counters().box_tests += 2;
+            double t_left, t_right;
+            bool hit_left  = slab_hit(r, nodes[n.offset].lo,     nodes[n.offset].hi,     ray_t, t_left);
+            bool hit_right = slab_hit(r, nodes[n.offset + 1].lo, nodes[n.offset + 1].hi, ray_t, t_right);
+
+            if (hit_left && hit_right) {
+                bool left_first = t_left <= t_right;
+                stack[top++] = n.offset + (left_first ? 1 : 0);
+                stack[top++] = n.offset + (left_first ? 0 : 1);
+            } else if (hit_left) {
+                stack[top++] = n.offset;
+            } else if (hit_right) {
+                stack[top++] = n.offset + 1;
+            }
+        }
+
+        return hit_anything;
+    }
+
+  private:
+    using node = compact_node;
+
+    // Non-owning handle to a palette material: the scene keeps it alive, and skipping the
+    // reference count keeps threads from contending on popular materials.
+    shared_ptr<material> material_handle(uint32_t index) const {
+        return borrow(materials[index].get());
+    }
+
+    bool hit_primitive(uint32_t ref, const ray& r, const interval& ray_t, hit_record& rec) const {
+        thread_counters().primitive_tests++;
+        switch (ref_type(ref)) {
+            case sphere_type: return hit_sphere(spheres[ref_index(ref)], r, ray_t, rec);
+            case cube_type:   return hit_cube(cubes[ref_index(ref)], r, ray_t, rec);
+            default:          return hit_tetrahedron(tetrahedra[ref_index(ref)], r, ray_t, rec);
+        }
+    }
+
+    bool hit_sphere(const compact_sphere& s, const ray& r, const interval& ray_t, hit_record& rec) const {
+        point3 center(s.center[0], s.center[1], s.center[2]);
+        double radius = s.radius;
+
+        vec3 oc = center - r.origin();
+        auto a = r.direction().length_squared();
+        auto h = dot(r.direction(), oc);
+        auto c = oc.length_squared() - radius*radius;
+
+        auto discriminant = h*h - a*c;
+        if (discriminant < 0)
+            return false;
+
+        auto sqrtd = std::sqrt(discriminant);
+        auto root = (h - sqrtd) / a;
+        if (!ray_t.surrounds(root)) {
+            root = (h + sqrtd) / a;
+            if (!ray_t.surrounds(root))
+                return false;
+        }
+
+        rec.t = root;
+        rec.p = r.at(rec.t);
+        rec.set_face_normal(r, (rec.p - center) / radius);
+        rec.mat = material_handle(s.material);
+        return true;
+    }
+
+    bool hit_cube(const compact_cube& b, const ray& r, const interval& ray_t, hit_record& rec) const {
+        double lo[3], hi[3];
+        for (int i = 0; i < 3; ++i) {
+            lo[i] = double(b.center[i]) - b.half_side;
+            hi[i] = double(b.center[i]) + b.half_side;
+        }
+
+        double t;
+        vec3 normal;
+        if (!box_surface_hit(r, lo, hi, ray_t, t, normal))
+            return false;
+
+        rec.t = t;
+        rec.p = r.at(rec.t);
+        rec.set_face_normal(r, normal);
+        rec.mat = material_handle(b.material);
+        return true;
+    }
+
+    bool hit_tetrahedron(const compact_tetrahedron& tet, const ray& r, const interval& ray_t, hit_record& rec) const {
+        const point3& o = r.origin();
+        const vec3& dir = r.direction();
+
+        double t_enter = -infinity, t_exit = infinity;
+        int enter_face = 0, exit_face = 0;
+        for (int i = 0; i < 4; i++) {
+            const float* p = tet.plane[i];
+            double denom = p[0]*dir.x() + p[1]*dir.y() + p[2]*dir.z();
+            double num = p[3] - (p[0]*o.x() + p[1]*o.y() + p[2]*o.z());
+
+            if (denom < 0) {
+                double t = num / denom;
+                if (t > t_enter) { t_enter = t; enter_face = i; }
+            } else if (denom > 0) {
+                double t = num / denom;
+                if (t < t_exit) { t_exit = t; exit_face = i; }
+            } else if (num < 0) {
+                return false;
+            }
+        }
+
+        if (t_enter > t_exit)
+            return false;
+
+        double t;
+        int face;
+        if (ray_t.surrounds(t_enter))     { t = t_enter; face = enter_face; }
+        else if (ray_t.surrounds(t_exit)) { t = t_exit;  face = exit_face; }
+        else return false;
+
+        rec.t = t;
+        rec.p = r.at(t);
+        rec.set_face_normal(r, vec3(tet.plane[face][0], tet.plane[face][1], tet.plane[face][2]));
+        rec.mat = material_handle(tet.material);
+        return true;
+    }
+};
+
+class compact_scene : public hittable {
+  public:
+    std::vector<shared_ptr<material>>  materials;  // Palette indexed by the primitives
+    std::vector<compact_sphere>        spheres;
+    std::vector<compact_cube>          cubes;
+    std::vector<compact_tetrahedron>   tetrahedra;
+
+    size_t primitive_count() const { return spheres.size() + cubes.size() + tetrahedra.size(); }
+
+    // Bytes held by primitives, references and BVH nodes (materials excluded).
+    size_t memory_bytes() const {
+        return spheres.capacity() * sizeof(compact_sphere)
+             + cubes.capacity() * sizeof(compact_cube)
+             + tetrahedra.capacity() * sizeof(compact_tetrahedron)
+             + refs.capacity() * sizeof(uint32_t)
+             + nodes.capacity() * sizeof(node);
+    }
+
+    // Builds the BVH over every primitive. The top of the tree is split serially until the
+    // remaining subtrees are small enough to share out; those are then built in parallel.
+    void build_acceleration(thread_pool* pool = nullptr) {
+        TRACE_SCOPE("compact BVH build");
+        auto count = primitive_count();
+        // Centers and extents are gathered up front so partitioning only touches this array.
+        std::vector<build_ref> build(count);
+        size_t k = 0;
+        for (uint32_t i = 0; i < spheres.size(); i++, k++)
+            build[k] = { { spheres[i].center[0], spheres[i].center[1], spheres[i].center[2] },
+                         spheres[i].radius, compact_view::make_ref(compact_view::sphere_type, i) };
+        for (uint32_t i = 0; i < cubes.size(); i++, k++)
+            build[k] = { { cubes[i].center[0], cubes[i].center[1], cubes[i].center[2] },
+                         cubes[i].half_side, compact_view::make_ref(compact_view::cube_type, i) };
+        for (uint32_t i = 0; i < tetrahedra.size(); i++, k++)
+            build[k] = { { tetrahedra[i].center[0], tetrahedra[i].center[1], tetrahedra[i].center[2] },
+                         tetrahedra[i].radius, compact_view::make_ref(compact_view::tetrahedron_type, i) };
+
+        // Leaves hold at least leaf_size/2 primitives, so there are at most `count` nodes.
+        nodes.assign(std::max<size_t>(count, 1), node());
+        node_count = 1;
+
+        std::vector<subtree> deferred;
+        // Subtrees of at most `grain` primitives are handed to the pool; 0 builds everything here.
+        size_t grain = pool ? std::max<size_t>(count / (8 * pool->size()), 4096) : 0;
+        build_node(build, 0, 0, count, grain, deferred);
+
+        if (!deferred.empty()) {
+            task_group subtrees(*pool);
+            for (const auto& sub : deferred) {
+                subtrees.run([this, &build, sub] {
+                    TRACE_SCOPE("BVH subtree build");
+                    std::vector<subtree> none;
+                    build_node(build, sub.node_index, sub.begin, sub.end, 0, none);
+                });
+            }
+            subtrees.wait();
+        }
+
+        refs.resize(count);
+        for (size_t i = 0; i < count; i++)
+            refs[i] = build[i].ref;
+
+        nodes.resize(node_count);
+        nodes.shrink_to_fit();
+        bbox = count ? node_box(nodes[0]) : aabb::empty;
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+        return view().hit(r, ray_t, rec);
+    }
+
+    // The arrays and BVH as a view, which is also the layout chunk files store them in.
+    compact_view view() const {
+        return { materials.data(), spheres.data(), cubes.data(), tetrahedra.data(),
+                 refs.data(), refs.size(), nodes.data(), nodes.size() };
+    }
+
+    aabb bounding_box() const override { return bbox; }
+
+  private:
+    static constexpr int      leaf_size        = 4;
+
+    using node = compact_node;
+
+    // A primitive's place in the BVH, with the center and half-size its bounds are taken from.
+    struct build_ref {
+        float    center[3];
+        float    extent;
+        uint32_t ref;
+    };
+
+    struct subtree {
+        uint32_t node_index;
+        size_t   begin, end;
+    };
+
+    std::vector<uint32_t> refs;   // See compact_view
+    std::vector<node>     nodes;
+    std::atomic<uint32_t> node_count{0};
+    aabb                  bbox;
+
+
+    static aabb node_box(const node& n) {
+        return aabb(interval(n.lo[0], n.hi[0]), interval(n.lo[1], n.hi[1]), interval(n.lo[2], n.hi[2]));
+    }
+
+    void build_node(std::vector<build_ref>& build, uint32_t node_index, size_t begin, size_t end, size_t grain,
+                    std::vector<subtree>& deferred) {
+        node& n = nodes[node_index];
+
+        // Bounds of the primitives and of their centers (the latter picks the split axis).
+        // Every primitive fits in the cube of side 2*extent around its center.
+        float lo[3] = { infinity_f, infinity_f, infinity_f }, hi[3] = { -infinity_f, -infinity_f, -infinity_f };
+        float center_lo[3] = { infinity_f, infinity_f, infinity_f }, center_hi[3] = { -infinity_f, -infinity_f, -infinity_f };
+        for (size_t k = begin; k < end; k++) {
+            const float* c = build[k].center;
+            float e = build[k].extent;
+            for (int a = 0; a < 3; a++) {
+                lo[a] = std::min(lo[a], c[a] - e);
+                hi[a] = std::max(hi[a], c[a] + e);
+                center_lo[a] = std::min(center_lo[a], c[a]);
+                center_hi[a] = std::max(center_hi[a], c[a]);
+            }
+        }
+        for (int a = 0; a < 3; a++) {
+            // Round outwards so float error can never shrink the box below its contents.
+            n.lo[a] = std::nextafter(lo[a], -infinity_f);
+            n.hi[a] = std::nextafter(hi[a], infinity_f);
+        }
+
+        size_t span = end - begin;
+        if (span <= size_t(leaf_size)) {
+            n.offset = uint32_t(begin);
+            n.count = uint32_t(span);
+            return;
+        }
+
+        int axis = 0;
+        for (int a = 1; a < 3; a++) {
+            if (center_hi[a] - center_lo[a] > center_hi[axis] - center_lo[axis])
+                axis = a;
+        }
+
+        auto mid = begin + span/2;
+        std::nth_element(build.begin() + begin, build.begin() + mid, build.begin() + end,
+            [axis](const build_ref& a, const build_ref& b) { return a.center[axis] < b.center[axis]; });
+
+        uint32_t left = node_count.fetch_add(2);
+        n.offset = left;
+        n.count = 0;
+
+        if (span <= grain) {
+            deferred.push_back({left, begin, mid});
+            deferred.push_back({left + 1, mid, end});
+            return;
+        }
+
+        build_node(build, left, begin, mid, grain, deferred);
+        build_node(build, left + 1, mid, end, grain, deferred);
+    }
+
+    static constexpr float infinity_f = std::numeric_limits<float>::infinity();
+};
+
+#endif
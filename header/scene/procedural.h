@@ -0,0 +1,325 @@
+#ifndef PROCEDURAL_H
+#define PROCEDURAL_H
+
+#include "scene/compact_scene.h"
+#include "objects/material.h"
+#include "utils/random_stream.h"
+#include "utils/thread_pool.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+    Seeded generator for large stress-test scenes of spheres, cubes and tetrahedra resting
+    above a ground plane. Primitives are written straight into a compact_scene's arrays in
+    parallel chunks; each chunk draws from its own stream seeded by (seed, type, chunk), so the
+    scene depends only on the parameters and seed, never on the thread count.
+
+    density is primitives per unit of ground area, so the field grows with count while
+    spacing stays fixed. clustering is the fraction of primitives placed in tight clusters
+    rather than spread uniformly.
+*/
+
+struct procedural_params {
+    size_t count            = 100000;
+    double density          = 1.0;
+    double clustering       = 0.3;
+    double sphere_fraction  = 0.6;   // The rest is split between cubes
+    double cube_fraction    = 0.2;   // and tetrahedra
+    int    material_count   = 64;    // Size of the shared material palette
+
+    // Parses "count=..,density=..,clustering=..,spheres=..,cubes=..,materials=..".
+    // Returns false on an unknown key, a malformed or out-of-range value, or a count whose
+    // largest primitive type would not fit the 30-bit index of a compact_view reference.
+    bool parse(const std::string& text) {
+        std::istringstream in(text);
+        std::string item;
+        while (std::getline(in, item, ',')) {
+            auto eq = item.find('=');
+            if (eq == std::string::npos)
+                return false;
+            auto key = item.substr(0, eq);
+            auto value = item.substr(eq + 1);
+
+            if (key == "count" || key == "materials") {
+                uint64_t whole;
+                if (!parse_whole(value, whole))
+                    return false;
+                if (key == "count") {
+                    // Three types of at most max_index + 1 each; the split is checked below.
+                    if (whole > 3 * (uint64_t(compact_view::max_index) + 1))
+                        return false;
+                    count = size_t(whole);
+                } else {
+                    if (whole > uint64_t(std::numeric_limits<int>::max()))
+                        return false;
+                    material_count = int(whole);
+                }
+                continue;
+            }
+
+            std::istringstream stream(value);
+            double number;
+            if (!(stream >> number) || !stream.eof() || !std::isfinite(number) || number < 0)
+                return false;
+
+            if      (key == "density")    density = number;
+            else if (key == "clustering") clustering = std::fmin(number, 1.0);
+            else if (key == "spheres")    sphere_fraction = number;
+            else if (key == "cubes")      cube_fraction = number;
+            else return false;
+        }
+        if (!(density > 0 && material_count > 0 && sphere_fraction + cube_fraction <= 1.0))
+            return false;
+
+        // Each primitive type is indexed separately, so check the split rather than the total.
+        size_t spheres = size_t(count * sphere_fraction);
+        size_t cubes = size_t(count * cube_fraction);
+        size_t tetrahedra = count - std::min(count, spheres + cubes);
+        size_t limit = size_t(compact_view::max_index) + 1;
+        return spheres <= limit && cubes <= limit && tetrahedra <= limit;
+    }
+
+  private:
+    // Accepts only a plain run of decimal digits that fits in 64 bits.
+    static bool parse_whole(const std::string& text, uint64_t& result) {
+        if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        errno = 0;
+        result = std::strtoull(text.c_str(), nullptr, 10);
+        return errno != ERANGE;
+    }
+};
+
+struct procedural_stats {
+    double generate_ms = 0;
+    double build_ms    = 0;
+    size_t primitives  = 0;
+    size_t bytes       = 0;
+
+    double bytes_per_primitive() const { return primitives ? double(bytes) / primitives : 0; }
+};
+
+class procedural_generator {
+  public:
+    procedural_generator(const procedural_params& params, uint64_t seed)
+      : params(params), seed(seed)
+    {
+        side = std::sqrt(params.count / params.density);
+        spacing = 1.0 / std::sqrt(params.density);
+
+        // About one cluster per thousand primitives, each a disk a few spacings across.
+        random_stream rng(sample_stream_seed(seed, 0, 0));
+        size_t cluster_count = std::max<size_t>(1, params.count / 1000);
+        cluster_radius = 0.5 * side / std::sqrt(double(cluster_count));
+        for (size_t c = 0; c < cluster_count; c++)
+            clusters.push_back({ (rng.next() - 0.5) * side, (rng.next() - 0.5) * side });
+    }
+
+    // Fills `out` (replacing its contents) and builds its BVH, using the pool if one is given.
+    void generate(compact_scene& out, thread_pool* pool, procedural_stats* stats = nullptr) {
+        using clock = std::chrono::steady_clock;
+        auto start = clock::now();
+
+        out.materials = palette();
+        out.spheres.resize(sphere_count());
+        out.cubes.resize(cube_count());
+        out.tetrahedra.resize(tetrahedron_count());
+
+        for_chunks(0, 0, chunks_of(out.spheres.size()), out.spheres.size(), pool, [&](size_t i, random_stream& rng) {
+            make_sphere(rng, out.spheres[i]);
+        });
+        for_chunks(1, 0, chunks_of(out.cubes.size()), out.cubes.size(), pool, [&](size_t i, random_stream& rng) {
+            make_cube(rng, out.cubes[i]);
+        });
+        for_chunks(2, 0, chunks_of(out.tetrahedra.size()), out.tetrahedra.size(), pool, [&](size_t i, random_stream& rng) {
+            make_tetrahedron(rng, out.tetrahedra[i]);
+        });
+
+        auto generated = clock::now();
+        out.build_acceleration(pool);
+        auto built = clock::now();
+
+        if (stats) {
+            stats->generate_ms = std::chrono::duration<double, std::milli>(generated - start).count();
+            stats->build_ms = std::chrono::duration<double, std::milli>(built - generated).count();
+            stats->primitives = out.primitive_count();
+            stats->bytes = out.memory_bytes();
+        }
+    }
+
+    // Generates the same primitives as generate(), but a batch of about batch_primitives at a
+    // time and without a BVH, so the whole field is never held at once. Each batch holds one
+    // primitive type (the other arrays are empty) and is passed to sink(const compact_scene&)
+    // in a fixed order, then reused.
+    template <typename Sink>
+    void generate_batches(size_t batch_primitives, thread_pool* pool, Sink&& sink) const {
+        size_t batch_chunks = std::max<size_t>(1, batch_primitives / chunk_size);
+        compact_scene batch;
+
+        auto batches = [&](uint64_t type, size_t count, auto& array, auto&& make) {
+            for (size_t first = 0; first < chunks_of(count); first += batch_chunks) {
+                size_t last = std::min(first + batch_chunks, chunks_of(count));
+                size_t base = first * chunk_size;
+                array.resize(std::min(count, last * chunk_size) - base);
+                for_chunks(type, first, last, count, pool, [&](size_t i, random_stream& rng) {
+                    make(rng, array[i - base]);
+                });
+                sink(static_cast<const compact_scene&>(batch));
+            }
+            array.clear();
+        };
+
+        batches(0, sphere_count(), batch.spheres, [this](random_stream& rng, compact_sphere& s) { make_sphere(rng, s); });
+        batches(1, cube_count(), batch.cubes, [this](random_stream& rng, compact_cube& b) { make_cube(rng, b); });
+        batches(2, tetrahedron_count(), batch.tetrahedra,
+                [this](random_stream& rng, compact_tetrahedron& t) { make_tetrahedron(rng, t); });
+    }
+
+    // The shared material palette primitives index into.
+    std::vector<shared_ptr<material>> palette() const {
+        random_stream rng(sample_stream_seed(seed, 0, 1));
+        std::vector<shared_ptr<material>> materials;
+        for (int m = 0; m < params.material_count; m++) {
+            auto choose_mat = rng.next();
+            if (choose_mat < 0.75) {
+                color albedo(rng.next() * rng.next(), rng.next() * rng.next(), rng.next() * rng.next());
+                materials.push_back(make_shared<lambertian>(albedo));
+            } else if (choose_mat < 0.93) {
+                color albedo(0.5 + 0.5*rng.next(), 0.5 + 0.5*rng.next(), 0.5 + 0.5*rng.next());
+                materials.push_back(make_shared<metal>(albedo, 0.5 * rng.next()));
+            } else {
+                materials.push_back(make_shared<dielectric>(1.5));
+            }
+        }
+        return materials;
+    }
+
+    double field_size() const { return side; }
+
+  private:
+    static constexpr size_t chunk_size = 1 << 16;
+
+    struct cluster { double x, z; };
+
+    procedural_params    params;
+    uint64_t             seed;
+    double               side;            // Width of the square field
+    double               spacing;         // Typical distance between neighbours
+    double               cluster_radius;
+    std::vector<cluster> clusters;
+
+    size_t sphere_count() const { return size_t(params.count * params.sphere_fraction); }
+    size_t cube_count() const { return size_t(params.count * params.cube_fraction); }
+    size_t tetrahedron_count() const { return params.count - sphere_count() - cube_count(); }
+
+    static size_t chunks_of(size_t count) { return (count + chunk_size - 1) / chunk_size; }
+
+    // Runs make(i, rng) for every index i of primitive type `type` in chunks [first, last),
+    // each chunk on the pool if one is given, drawing from that chunk's own stream.
+    template <typename Make>
+    void for_chunks(uint64_t type, size_t first, size_t last, size_t count, thread_pool* pool, Make&& make) const {
+        auto run_chunk = [&, type, count](size_t chunk) {
+            random_stream rng(sample_stream_seed(seed, type + 1, chunk));
+            size_t end = std::min(count, (chunk + 1) * chunk_size);
+            for (size_t i = chunk * chunk_size; i < end; i++)
+                make(i, rng);
+        };
+
+        if (!pool) {
+            for (size_t chunk = first; chunk < last; chunk++)
+                run_chunk(chunk);
+            return;
+        }
+        task_group group(*pool);
+        for (size_t chunk = first; chunk < last; chunk++) {
+            group.run([&run_chunk, chunk] {
+                TRACE_SCOPE("generate chunk");
+                run_chunk(chunk);
+            });
+        }
+        group.wait();
+    }
+
+    uint32_t pick_material(random_stream& rng) const {
+        return std::min(uint32_t(rng.next() * params.material_count), uint32_t(params.material_count - 1));
+    }
+
+    double size(random_stream& rng) const {
+        return spacing * (0.15 + 0.2 * rng.next());
+    }
+
+    // Picks a spot on the field (in a cluster or anywhere) and lifts the object by its extent
+    // so it rests on or floats a little above the ground.
+    void place(random_stream& rng, double extent, float center[3]) const {
+        double x, z;
+        if (rng.next() < params.clustering) {
+            const auto& c = clusters[std::min(size_t(rng.next() * clusters.size()), clusters.size() - 1)];
+            double r = cluster_radius * std::sqrt(rng.next());
+            double theta = 2 * pi * rng.next();
+            x = c.x + r * std::cos(theta);
+            z = c.z + r * std::sin(theta);
+        } else {
+            x = (rng.next() - 0.5) * side;
+            z = (rng.next() - 0.5) * side;
+        }
+
+        center[0] = float(x);
+        center[1] = float(extent * (1 + 2 * rng.next()));
+        center[2] = float(z);
+    }
+
+    void make_sphere(random_stream& rng, compact_sphere& s) const {
+        s.radius = float(size(rng));
+        place(rng, s.radius, s.center);
+        s.material = pick_material(rng);
+    }
+
+    void make_cube(random_stream& rng, compact_cube& b) const {
+        b.half_side = float(0.8 * size(rng));
+        place(rng, b.half_side, b.center);
+        b.material = pick_material(rng);
+    }
+
+    // A regular tetrahedron in a random orientation.
+    void make_tetrahedron(random_stream& rng, compact_tetrahedron& tet) const {
+        double circumradius = size(rng);
+        // The bounding radius gets a little slack for the rounding of the float planes.
+        tet.radius = float(1.001 * circumradius);
+        place(rng, circumradius, tet.center);
+        tet.material = pick_material(rng);
+
+        // Random orthonormal frame from a uniformly random axis.
+        auto z = 1 - 2*rng.next();
+        auto r = std::sqrt(std::fmax(0.0, 1 - z*z));
+        auto phi = 2*pi*rng.next();
+        vec3 w(r*std::cos(phi), r*std::sin(phi), z);
+        vec3 a = std::fabs(w.x()) > 0.9 ? vec3(0,1,0) : vec3(1,0,0);
+        vec3 v = unit_vector(cross(w, a));
+        vec3 u = cross(w, v);
+
+        // Vertex directions of a regular tetrahedron; face i (opposite vertex i) has outward
+        // normal -vertex_i and lies at the inradius, a third of the circumradius.
+        static const vec3 corners[4] = {
+            vec3( 1,  1,  1), vec3( 1, -1, -1), vec3(-1,  1, -1), vec3(-1, -1,  1)
+        };
+        point3 center(tet.center[0], tet.center[1], tet.center[2]);
+        for (int i = 0; i < 4; i++) {
+            vec3 c = unit_vector(corners[i]);
+            vec3 n = -(c.x()*u + c.y()*v + c.z()*w);
+            tet.plane[i][0] = float(n.x());
+            tet.plane[i][1] = float(n.y());
+            tet.plane[i][2] = float(n.z());
+            tet.plane[i][3] = float(dot(n, center) + circumradius / 3.0);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "utils/rtweekend.h"
+#include "camera/camera.h"
+#include "objects/bvh.h"
+#include "objects/hittable_list.h"
+#include "objects/sphere.h"
+#include "objects/tetrahedron.h"
+#include "objects/cube.h"
+#include "objects/material.h"
+#include "scene/procedural.h"
+#include "scene/chunked_scene.h"
+
+#include <string>
+#include <vector>
+
+/*
+    Named reference scenes. A scene bundles its objects, the acceleration structure built
+    over them and the camera it was composed for, so callers (main, the render server)
+    can build one by name and only override the camera settings they care about.
+
+    Primitives, materials and BVH nodes all live in the scene's arena; the shared_ptrs in
+    objects and root don't own them, so they are only valid while the scene is. Scenes are
+    move-only for that reason.
+*/
+
+struct scene {
+    scene_arena          arena;    // Storage for every primitive, material and BVH node
+    hittable_list        objects;  // Top-level primitives in the scene
+    shared_ptr<hittable> root;     // Acceleration structure that rays are traced against
+    camera               view;     // Default camera for the scene
+
+    void build_acceleration() {
+        TRACE_SCOPE("BVH build");
+        root = borrow(arena.make_unmanaged<bvh_node>(objects, &arena));
+    }
+};
+
+// The final scene of Ray Tracing in One Weekend: a 22x22 grid of small random spheres
+// around three large ones.
+inline scene random_spheres_scene(unsigned int seed = 0) {
+    scene sc;
+    auto& world = sc.objects;
+
+    // Scene layout comes from the RNG, so pin it to make the same seed give the same scene
+    // regardless of which thread builds it.
+    seed_random(seed);
+
+    auto ground_material = borrow(sc.arena.make_unmanaged<lambertian>(color(0.5, 0.5, 0.5)));
+    world.add(borrow(sc.arena.make_unmanaged<sphere>(point3(0,-1000,0), 1000, ground_material)));
+
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            auto choose_mat = random_double();
+            point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
+
+            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
+                shared_ptr<material> sphere_material;
+
+                if (choose_mat < 0.8) {
+                    // diffuse
+                    auto albedo = color::random() * color::random();
+                    sphere_material = borrow(sc.arena.make_unmanaged<lambertian>(albedo));
+                    world.add(borrow(sc.arena.make_unmanaged<sphere>(center, 0.2, sphere_material)));
+                } else if (choose_mat < 0.95) {
+                    // metal
+                    auto albedo = color::random(0.5, 1);
+                    auto fuzz = random_double(0, 0.5);
+                    sphere_material = borrow(sc.arena.make_unmanaged<metal>(albedo, fuzz));
+                    world.add(borrow(sc.arena.make_unmanaged<sphere>(center, 0.2, sphere_material)));
+                } else {
+                    // glass
+                    sphere_material = borrow(sc.arena.make_unmanaged<dielectric>(1.5));
+                    world.add(borrow(sc.arena.make_unmanaged<sphere>(center, 0.2, sphere_material)));
+                }
+            }
+        }
+    }
+
+    auto material1 = borrow(sc.arena.make_unmanaged<dielectric>(1.5));
+    world.add(borrow(sc.arena.make_unmanaged<sphere>(point3(0, 1, 0), 1.0, material1)));
+
+    auto material2 = borrow(sc.arena.make_unmanaged<lambertian>(color(0.4, 0.2, 0.1)));
+    world.add(borrow(sc.arena.make_unmanaged<sphere>(point3(-4, 1, 0), 1.0, material2)));
+
+    auto material3 = borrow(sc.arena.make_unmanaged<metal>(color(0.7, 0.6, 0.5), 0.0));
+    world.add(borrow(sc.arena.make_unmanaged<sphere>(point3(4, 1, 0), 1.0, material3)));
+
+    camera& cam = sc.view;
+
+    cam.aspect_ratio      = 16.0 / 9.0;
+    cam.image_width       = 1200;
+    cam.samples_per_pixel = 500;
+    cam.max_depth         = 50;
+
+    cam.vfov     = 20;
+    cam.lookfrom = point3(13,2,3);
+    cam.lookat   = point3(0,0,0);
+    cam.vup      = vec3(0,1,0);
+
+    cam.defocus_angle = 0.6;
+    cam.focus_dist    = 10.0;
+
+    sc.build_acceleration();
+    return sc;
+}
+
+// A handful of spheres next to a floating cube and a tetrahedron, one of each material.
+inline scene showcase_scene(unsigned int seed = 0) {
+    scene sc;
+    auto& world = sc.objects;
+
+    seed_random(seed);
+
+    // Define materials
+    auto material_ground = borrow(sc.arena.make_unmanaged<lambertian>(color(0.2, 0.8, 0.2)));
+    auto material_center = borrow(sc.arena.make_unmanaged<lambertian>(color(0.1, 0.2, 0.5)));
+    auto material_left   = borrow(sc.arena.make_unmanaged<dielectric>(1.50));
+    auto material_bubble = borrow(sc.arena.make_unmanaged<dielectric>(1.00 / 1.50));
+    auto material_right  = borrow(sc.arena.make_unmanaged<metal>(color(0.8, 0.6, 0.2), 1.0));
+    auto material_cube = borrow(sc.arena.make_unmanaged<metal>(color(0.95, 0.64, 0.54), 1.0));  // Copper-like color and slight roughness
+    auto material_tetra = borrow(sc.arena.make_unmanaged<metal>(color(0.9, 0.2, 0.2), 0.8));  // Red metal with slight roughness
+
+    // Add spheres
+    world.add(borrow(sc.arena.make_unmanaged<sphere>(point3( 0.0, -100.5, -1.0), 100.0, material_ground)));
+    world.add(borrow(sc.arena.make_unmanaged<sphere>(point3( 0.0,    0.0, -1.2),   0.5, material_center)));
+    world.add(borrow(sc.arena.make_unmanaged<sphere>(point3(-1.0,    0.0, -1.0),   0.5, material_left)));
+    world.add(borrow(sc.arena.make_unmanaged<sphere>(point3(-1.0,    0.0, -1.0),   0.4, material_bubble)));
+    world.add(borrow(sc.arena.make_unmanaged<sphere>(point3( 1.0,    0.0, -1.0),   0.5, material_right)));
+
+    // Add a floating cube
+    world.add(borrow(sc.arena.make_unmanaged<cube>(point3(-0.5, 0.5, -2.8), 1.0, material_cube)));
+
+    // Add a tetrahedron
+    world.add(borrow(sc.arena.make_unmanaged<tetrahedron>(
+        point3(1.5, 0.0, -2.5),  // Base vertex
+        point3(2.0, 0.0, -2.0),  // Second base vertex
+        point3(1.5, 0.0, -3.0),  // Third base vertex
+        point3(1.7, 1.0, -2.5),  // Apex vertex
+        material_tetra
+    )));
+
+    camera& cam = sc.view;
+
+    cam.aspect_ratio      = 16.0 / 9.0;
+    cam.image_width       = 400;
+    cam.samples_per_pixel = 100;
+    cam.max_depth         = 50;
+
+    cam.vfov     = 30;
+    cam.lookfrom = point3(-2,2,1);
+    cam.lookat   = point3(0,0,-1);
+    cam.vup      = vec3(0,1,0);
+
+    cam.defocus_angle = 10.0;
+    cam.focus_dist    = 3.4;
+
+    sc.build_acceleration();
+    return sc;
+}
+
+// Adds the ground under a generated field and points the camera at it from above one edge.
+inline void add_procedural_surroundings(scene& sc, const procedural_generator& generator) {
+    auto ground_material = borrow(sc.arena.make_unmanaged<lambertian>(color(0.5, 0.5, 0.5)));
+    double ground_radius = 1000 + 10 * generator.field_size();
+    sc.objects.add(borrow(sc.arena.make_unmanaged<sphere>(point3(0, -ground_radius, 0), ground_radius, ground_material)));
+
+    camera& cam = sc.view;
+    double side = generator.field_size();
+
+    cam.aspect_ratio      = 16.0 / 9.0;
+    cam.image_width       = 400;
+    cam.samples_per_pixel = 16;
+    cam.max_depth         = 8;
+
+    cam.vfov     = 40;
+    cam.lookfrom = point3(0, 0.4*side + 2, 0.9*side + 4);
+    cam.lookat   = point3(0, 0, 0);
+    cam.vup      = vec3(0,1,0);
+}
+
+// A generated field of spheres, cubes and tetrahedra (see procedural.h) on a ground plane,
+// seen from above one edge. Primitives live in one compact_scene rather than as separate objects.
+inline scene procedural_scene(const procedural_params& params, unsigned int seed = 0,
+                              thread_pool* pool = nullptr, procedural_stats* stats = nullptr) {
+    scene sc;
+
+    auto field = borrow(sc.arena.make<compact_scene>());
+    procedural_generator generator(params, seed);
+    generator.generate(*field, pool, stats);
+
+    add_procedural_surroundings(sc, generator);
+    sc.objects.add(field);
+
+    sc.build_acceleration();
+    return sc;
+}
+
+// The procedural scene traced out of core: the field is generated in batches straight into
+// chunk files of at most chunk_primitives in dir, never held whole; rendering then maps chunks
+// on demand through a cache of at most cache_bytes. The chunked geometry is returned in streamed.
+inline bool procedural_streamed_scene(const procedural_params& params, unsigned int seed,
+                                      const std::string& dir, size_t chunk_primitives, size_t cache_bytes,
+                                      thread_pool* pool, scene& out, shared_ptr<chunked_scene>& streamed) {
+    procedural_generator generator(params, seed);
+    auto palette = generator.palette();
+
+    // Binned straight to disk as it is generated: the whole field is never in memory, and no
+    // BVH is built over it, only one per chunk.
+    double half = 0.5 * generator.field_size();
+    chunked_scene::writer writer(dir, chunk_primitives, params.count, -half, half, -half, half, pool);
+    generator.generate_batches(size_t(1) << 20, pool, [&writer](const compact_scene& batch) { writer.add(batch); });
+    if (!writer.finish(palette.size()))
+        return false;
+
+    streamed = make_shared<chunked_scene>();
+    if (!streamed->open(dir, palette, cache_bytes))
+        return false;
+
+    out = scene();
+    add_procedural_surroundings(out, generator);
+    out.objects.add(streamed);
+    out.build_acceleration();
+    return true;
+}
+
+inline std::vector<std::string> scene_names() {
+    return { "random_spheres", "showcase", "procedural[:count=N,density=D,clustering=C,...]" };
+}
+
+// Parses "procedural[:k=v,...]". Returns false for any other name or malformed parameters.
+inline bool parse_procedural_name(const std::string& name, procedural_params& params) {
+    const std::string procedural_prefix = "procedural";
+    if (name.compare(0, procedural_prefix.size(), procedural_prefix) != 0)
+        return false;
+    auto rest = name.substr(procedural_prefix.size());
+    return rest.empty() || (rest[0] == ':' && params.parse(rest.substr(1)));
+}
+
+// Builds the named scene. Returns false if no scene with that name exists (or a procedural
+// scene's parameters don't parse). Procedural scenes are generated on the pool if one is
+// given (the caller's, so builds don't add threads on top of rendering), else on this thread.
+inline bool build_scene(const std::string& name, unsigned int seed, scene& out, thread_pool* pool = nullptr) {
+    TRACE_SCOPE("scene setup");
+
+    auto report_arena = [&out] {
+        std::clog << "Scene arena: " << out.arena.object_count() << " objects, "
+                  << out.arena.bytes_used() << " bytes, " << out.arena.bytes_per_object()
+                  << " bytes per object\n";
+    };
+
+    if (name == "random_spheres") { out = random_spheres_scene(seed); report_arena(); return true; }
+    if (name == "showcase")       { out = showcase_scene(seed);       report_arena(); return true; }
+
+    procedural_params params;
+    if (parse_procedural_name(name, params)) {
+        procedural_stats stats;
+        out = procedural_scene(params, seed, pool, &stats);
+        std::clog << "Generated " << stats.primitives << " primitives in " << stats.generate_ms
+                  << " ms, BVH built in " << stats.build_ms << " ms, "
+                  << stats.bytes_per_primitive() << " bytes per primitive\n";
+        report_arena();
+        return true;
+    }
+
+    return false;
+}
+
+#endif
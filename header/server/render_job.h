@@ -0,0 +1,162 @@
+#ifndef RENDER_JOB_H
+#define RENDER_JOB_H
+
+#include "camera/camera.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+
+/*
+    One render request, sent to the server as a single line of space-separated key=value
+    pairs, e.g.
+
+        scene=random_spheres width=400 spp=20 lookfrom=13,2,3 output=/tmp/thumb.ppm
+
+    Only "scene" is required. Camera keys that are left out keep the scene's own default.
+
+        scene     name of a registered scene          seed      scene layout seed (default 0)
+        width     image width in pixels               aspect    width / height
+        spp       samples per pixel                   depth     maximum bounce depth
+        vfov      vertical field of view, degrees     lookfrom  camera position, as x,y,z
+        lookat    point the camera looks at, x,y,z    vup       camera up direction, x,y,z
+        defocus   defocus angle, degrees              focus     focus distance
+        output    write the image to this path on the server instead of returning it
+        budget    render for this many seconds instead of a fixed spp (spp then caps the samples)
+
+    Jobs come from untrusted clients, so frame size, spp, depth and budget are capped (see the
+    limits below) rather than left to fail an allocation mid-render.
+*/
+
+struct render_job {
+    static constexpr double max_pixels      = 4096.0 * 4096.0;  // width * height
+    static constexpr int    max_spp         = 1 << 16;
+    static constexpr int    max_depth       = 1024;
+    static constexpr double max_time_budget = 3600;             // Seconds
+
+    std::string  scene_name;
+    unsigned int seed = 0;
+    std::string  output_path;  // Empty means the image is sent back over the socket
+    double       time_budget = 0;  // Seconds; 0 renders exactly samples_per_pixel
+    std::map<std::string, std::string> camera_settings;
+
+    // Overrides the camera fields named in the job. Returns false and fills `error` on bad input.
+    bool apply(camera& cam, std::string& error) const {
+        for (const auto& [key, value] : camera_settings) {
+            bool ok = true;
+            if      (key == "width")    ok = parse_int(value, cam.image_width) && cam.image_width > 0;
+            else if (key == "aspect")   ok = parse_double(value, cam.aspect_ratio) && cam.aspect_ratio > 0;
+            else if (key == "spp")      ok = parse_int(value, cam.samples_per_pixel)
+                                             && cam.samples_per_pixel > 0 && cam.samples_per_pixel <= max_spp;
+            else if (key == "depth")    ok = parse_int(value, cam.max_depth)
+                                             && cam.max_depth > 0 && cam.max_depth <= max_depth;
+            else if (key == "vfov")     ok = parse_double(value, cam.vfov);
+            else if (key == "lookfrom") ok = parse_vec3(value, cam.lookfrom);
+            else if (key == "lookat")   ok = parse_vec3(value, cam.lookat);
+            else if (key == "vup")      ok = parse_vec3(value, cam.vup);
+            else if (key == "defocus")  ok = parse_double(value, cam.defocus_angle);
+            else if (key == "focus")    ok = parse_double(value, cam.focus_dist);
+            else {
+                error = "unknown key '" + key + "'";
+                return false;
+            }
+
+            if (!ok) {
+                error = "bad value for '" + key + "': " + value;
+                return false;
+            }
+        }
+
+        // Checked on the combination, since either width or aspect can blow up the height.
+        double height = std::max(1.0, std::floor(cam.image_width / cam.aspect_ratio));
+        if (cam.image_width * height > max_pixels) {
+            error = "image too large: at most " + std::to_string(long(max_pixels)) + " pixels";
+            return false;
+        }
+        return true;
+    }
+
+    // Batch view lists (see main.cc) leave the scene out, so it can be made optional.
+    static bool parse(const std::string& line, render_job& job, std::string& error, bool require_scene = true) {
+        std::istringstream in(line);
+        std::string token;
+        while (in >> token) {
+            auto eq = token.find('=');
+            if (eq == std::string::npos || eq == 0) {
+                error = "expected key=value, got '" + token + "'";
+                return false;
+            }
+
+            auto key = token.substr(0, eq);
+            auto value = token.substr(eq + 1);
+
+            if (key == "scene") {
+                job.scene_name = value;
+            } else if (key == "seed") {
+                int seed;
+                if (!parse_int(value, seed) || seed < 0) {
+                    error = "bad value for 'seed': " + value;
+                    return false;
+                }
+                job.seed = unsigned(seed);
+            } else if (key == "output") {
+                job.output_path = value;
+            } else if (key == "budget") {
+                if (!parse_double(value, job.time_budget) || !(job.time_budget > 0)
+                    || job.time_budget > max_time_budget) {
+                    error = "bad value for 'budget': " + value;
+                    return false;
+                }
+            } else {
+                job.camera_settings[key] = value;
+            }
+        }
+
+        if (require_scene && job.scene_name.empty()) {
+            error = "missing scene=<name>";
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    static bool parse_double(const std::string& text, double& out) {
+        char* end = nullptr;
+        double value = std::strtod(text.c_str(), &end);
+        if (text.empty() || *end != '\0')
+            return false;
+        out = value;
+        return true;
+    }
+
+    static bool parse_int(const std::string& text, int& out) {
+        char* end = nullptr;
+        errno = 0;
+        long value = std::strtol(text.c_str(), &end, 10);
+        if (text.empty() || *end != '\0' || errno == ERANGE || value > INT_MAX || value < INT_MIN)
+            return false;
+        out = int(value);
+        return true;
+    }
+
+    static bool parse_vec3(const std::string& text, vec3& out) {
+        std::istringstream in(text);
+        std::string part;
+        vec3 v;
+        for (int axis = 0; axis < 3; axis++) {
+            if (!std::getline(in, part, ',') || !parse_double(part, v[axis]))
+                return false;
+        }
+        if (std::getline(in, part, ','))
+            return false;
+        out = v;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,315 @@
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include "scene/scenes.h"
+#include "server/render_job.h"
+#include "server/socket_io.h"
+#include "utils/image.h"
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <list>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+    Long-running render service. Jobs arrive over a local Unix socket, one request line per
+    connection (see render_job.h). Built scenes and their BVHs are kept in a cache keyed by
+    scene name and seed, so only the first job for a scene pays for building it; every job
+    then renders its scanlines on one shared thread pool. The cache holds a bounded number of
+    scenes and drops the least recently used, since clients can ask for any procedural size
+    and seed.
+
+    Replies are a single line, optionally followed by a payload:
+
+        ok path=<file> width=<w> height=<h> ms=<render time>     image written on the server
+        ok ppm=<bytes> width=<w> height=<h> ms=<render time>     followed by <bytes> of PPM
+
+    Time-budgeted jobs also report spp=<average samples per pixel achieved>.
+        ok scenes=<cached> jobs=<completed>                      reply to "stats"
+        ok shutdown                                              reply to "shutdown"
+        error <message>
+*/
+
+// Scenes are immutable once built, so any number of jobs can trace against one concurrently.
+// At most `capacity` scenes are kept; past that the least recently requested finished builds
+// are dropped. Jobs still rendering an evicted scene hold their own shared_ptr to it, so it
+// is freed when the last of them is done.
+class scene_cache {
+  public:
+    // Procedural scenes are generated on `pool` (the server's render pool) if given.
+    explicit scene_cache(thread_pool* pool = nullptr, size_t capacity = 16)
+      : pool(pool), capacity(std::max<size_t>(capacity, 1)) {}
+
+    // Returns the cached scene, building it on first use. Concurrent requests for a scene
+    // that is still being built wait for that build instead of starting their own. Returns
+    // null for an unknown name; rethrows (to every waiter) if the build itself threw.
+    shared_ptr<const scene> get(const std::string& name, unsigned int seed) {
+        auto key = name + "#" + std::to_string(seed);
+        std::promise<shared_ptr<const scene>> build;
+        std::shared_future<shared_ptr<const scene>> entry;
+        bool builder = false;
+
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            auto found = entries.find(key);
+            if (found != entries.end()) {
+                entry = found->second.built;
+                recent.splice(recent.begin(), recent, found->second.recent_position);
+            } else {
+                entry = build.get_future().share();
+                recent.push_front(key);
+                entries.emplace(key, cache_entry{ entry, recent.begin() });
+                builder = true;
+                evict();
+            }
+        }
+
+        if (builder) {
+            shared_ptr<scene> sc;
+            std::exception_ptr failure;
+            try {
+                sc = make_shared<scene>();
+                if (!build_scene(name, seed, *sc, pool))
+                    sc.reset();
+            } catch (...) {
+                // Typically bad_alloc on a huge procedural scene. Waiting jobs get the same
+                // exception rather than blocking forever.
+                failure = std::current_exception();
+                sc.reset();
+            }
+
+            // Unknown names and failed builds are not worth remembering. Dropped before the
+            // result is published: until then eviction skips the entry, so it is still ours.
+            if (!sc) {
+                std::lock_guard<std::mutex> lock(cache_mutex);
+                auto failed = entries.find(key);
+                recent.erase(failed->second.recent_position);
+                entries.erase(failed);
+            }
+
+            if (failure)
+                build.set_exception(failure);
+            else
+                build.set_value(sc);
+        }
+
+        return entry.get();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        return entries.size();
+    }
+
+  private:
+    struct cache_entry {
+        std::shared_future<shared_ptr<const scene>> built;
+        std::list<std::string>::iterator            recent_position;
+    };
+
+    thread_pool* pool;
+    size_t       capacity;
+    std::mutex   cache_mutex;
+    std::map<std::string, cache_entry> entries;
+    std::list<std::string>             recent;  // Keys, most recently requested first
+
+    // Drops least recently used scenes until within capacity. Builds still in progress are
+    // skipped: their waiters need the entry. Called with cache_mutex held.
+    void evict() {
+        auto position = recent.end();
+        while (entries.size() > capacity && position != recent.begin()) {
+            --position;
+            auto entry = entries.find(*position);
+            if (entry->second.built.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                continue;
+            entries.erase(entry);
+            position = recent.erase(position);
+        }
+    }
+};
+
+class render_server {
+  public:
+    render_server(const std::string& socket_path, unsigned int thread_count)
+      : socket_path(socket_path), pool(thread_count), scenes(&pool) {}
+
+    ~render_server() {
+        if (listen_fd >= 0)
+            ::close(listen_fd);
+    }
+
+    // Accepts connections until a "shutdown" request arrives. Each connection is served on its
+    // own thread; the rendering itself happens on the shared pool. Returns false if the socket
+    // could not be set up.
+    bool run() {
+        sockaddr_un addr;
+        if (!make_socket_address(socket_path, addr)) {
+            std::clog << "Socket path too long: " << socket_path << '\n';
+            return false;
+        }
+
+        listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0) {
+            std::clog << "Could not create socket\n";
+            return false;
+        }
+
+        ::unlink(socket_path.c_str());
+        if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+            || ::listen(listen_fd, 64) < 0) {
+            std::clog << "Could not listen on " << socket_path << '\n';
+            return false;
+        }
+
+        std::clog << "Listening on " << socket_path << " with " << pool.size() << " render threads\n";
+
+        auto backoff = std::chrono::milliseconds(0);
+        while (!stopping) {
+            int client_fd = ::accept(listen_fd, nullptr, nullptr);
+            if (client_fd < 0) {
+                if (stopping || errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                // Out of descriptors or memory: wait for connections to close, backing off up to
+                // a second. Anything else means the socket itself is broken.
+                if (errno != EMFILE && errno != ENFILE && errno != ENOBUFS && errno != ENOMEM) {
+                    std::clog << "accept failed: " << std::strerror(errno) << "; stopping\n";
+                    stopping = true;
+                    break;
+                }
+                backoff = std::min(std::max(2 * backoff, std::chrono::milliseconds(10)),
+                                   std::chrono::milliseconds(1000));
+                std::this_thread::sleep_for(backoff);
+                continue;
+            }
+            backoff = std::chrono::milliseconds(0);
+
+            active_connections++;
+            std::thread([this, client_fd] {
+                serve_connection(client_fd);
+                ::close(client_fd);
+                active_connections--;
+            }).detach();
+        }
+
+        // Let in-flight jobs finish before the pool goes away.
+        while (active_connections > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        ::close(listen_fd);
+        listen_fd = -1;
+        ::unlink(socket_path.c_str());
+        std::clog << "Server stopped after " << completed_jobs << " jobs\n";
+        return true;
+    }
+
+  private:
+    std::string socket_path;
+    thread_pool pool;
+    scene_cache scenes;
+    int listen_fd = -1;
+    std::atomic<bool> stopping{false};
+    std::atomic<int> active_connections{0};
+    std::atomic<size_t> completed_jobs{0};
+
+    void serve_connection(int fd) {
+        std::string line;
+        if (!read_line(fd, line))
+            return;
+
+        if (line == "shutdown") {
+            write_all(fd, "ok shutdown\n");
+            stopping = true;
+            // Wake the accept() call in run() so it notices the flag.
+            ::shutdown(listen_fd, SHUT_RDWR);
+            return;
+        }
+
+        if (line == "stats") {
+            write_all(fd, "ok scenes=" + std::to_string(scenes.size())
+                        + " jobs=" + std::to_string(completed_jobs) + "\n");
+            return;
+        }
+
+        TRACE_SCOPE("job");
+        render_job job;
+        std::string error;
+        if (!render_job::parse(line, job, error)) {
+            write_all(fd, "error " + error + "\n");
+            return;
+        }
+
+        shared_ptr<const scene> sc;
+        try {
+            sc = scenes.get(job.scene_name, job.seed);
+        } catch (const std::exception& e) {
+            write_all(fd, "error could not build scene '" + job.scene_name + "': " + e.what() + "\n");
+            return;
+        }
+        if (!sc) {
+            write_all(fd, "error unknown scene '" + job.scene_name + "'\n");
+            return;
+        }
+
+        camera cam = sc->view;
+        if (!job.apply(cam, error)) {
+            write_all(fd, "error " + error + "\n");
+            return;
+        }
+
+        // This runs on a detached connection thread, where an escaping exception (bad_alloc,
+        // most likely) would terminate the whole server. Fail just this job instead.
+        std::string reply, payload;
+        try {
+            auto start = std::chrono::steady_clock::now();
+            image_buffer img;
+            budget_report report;
+            if (job.time_budget > 0)
+                cam.render(*sc->root, img, job.time_budget, &pool, &report);
+            else
+                cam.render(*sc->root, img, &pool);
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            completed_jobs++;
+
+            auto details = " width=" + std::to_string(img.width) + " height=" + std::to_string(img.height)
+                         + " ms=" + std::to_string(ms);
+            if (job.time_budget > 0)
+                details += " spp=" + std::to_string(report.mean_spp);
+            details += "\n";
+
+            if (!job.output_path.empty()) {
+                if (!img.write_ppm(job.output_path))
+                    reply = "error could not write " + job.output_path + "\n";
+                else
+                    reply = "ok path=" + job.output_path + details;
+            } else {
+                std::ostringstream ppm;
+                img.write_ppm(ppm);
+                payload = ppm.str();
+                reply = "ok ppm=" + std::to_string(payload.size()) + details;
+            }
+        } catch (const std::exception& e) {
+            write_all(fd, std::string("error render failed: ") + e.what() + "\n");
+            return;
+        }
+
+        if (write_all(fd, reply) && !payload.empty())
+            write_all(fd, payload);
+    }
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef SOCKET_IO_H
+#define SOCKET_IO_H
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+    Small blocking helpers over a Unix-domain stream socket, shared by the render server
+    and the command-line client. Every message starts with one '\n'-terminated text line;
+    image replies are followed by a raw payload whose byte count is given on that line.
+*/
+
+inline bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        // MSG_NOSIGNAL: a client hanging up mid-reply must not raise SIGPIPE and kill the server.
+        auto written = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (written <= 0)
+            return false;
+        data += written;
+        size -= size_t(written);
+    }
+    return true;
+}
+
+inline bool write_all(int fd, const std::string& data) {
+    return write_all(fd, data.data(), data.size());
+}
+
+inline bool read_exact(int fd, char* data, size_t size) {
+    while (size > 0) {
+        auto count = ::read(fd, data, size);
+        if (count <= 0)
+            return false;
+        data += count;
+        size -= size_t(count);
+    }
+    return true;
+}
+
+// Reads up to (and drops) the next '\n'. Returns false if the peer closed before one arrived,
+// or if the line runs past max_length (so a client can't make the server buffer without end).
+inline bool read_line(int fd, std::string& line, size_t max_length = 4096) {
+    line.clear();
+    char c;
+    while (true) {
+        auto count = ::read(fd, &c, 1);
+        if (count <= 0)
+            return false;
+        if (c == '\n')
+            return true;
+        if (line.size() == max_length)
+            return false;
+        line.push_back(c);
+    }
+}
+
+inline bool make_socket_address(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        return false;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Returns a connected socket, or -1 on failure.
+inline int connect_unix_socket(const std::string& path) {
+    sockaddr_un addr;
+    if (!make_socket_address(path, addr))
+        return -1;
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+    Bump allocator for scene objects. Primitives, materials and BVH nodes are constructed
+    back to back in large blocks instead of each getting its own heap allocation (plus a
+    shared_ptr control block), and everything is destroyed and freed in one go when the
+    arena is.
+
+    Objects are handed out as plain pointers: they never move, and stay valid exactly as long
+    as the arena. make<T>() records T's destructor to run at teardown (unless T is trivially
+    destructible). make_unmanaged<T>() skips that, and the 16 bytes per object it would cost,
+    for objects that own nothing outside the arena: materials, and primitives and BVH nodes
+    whose shared_ptr members only borrow() other arena objects.
+
+    The rest of the tracer passes shared_ptrs around, so borrow() wraps an arena pointer in a
+    shared_ptr without a control block. It owns nothing, and must not outlive the arena.
+    Allocation is not thread-safe; build a scene on one thread.
+*/
+
+class scene_arena {
+  public:
+    explicit scene_arena(size_t block_size = size_t(1) << 20)
+      : storage(std::make_unique<arena_storage>(block_size)) {}
+
+    scene_arena(scene_arena&&) = default;
+    scene_arena& operator=(scene_arena&&) = default;
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        T* object = make_unmanaged<T>(std::forward<Args>(args)...);
+        if constexpr (!std::is_trivially_destructible_v<T>)
+            storage->destructors.push_back({ object, [](void* p) { static_cast<T*>(p)->~T(); } });
+        return object;
+    }
+
+    // As make(), but T's destructor is never run. Only for objects that own nothing outside
+    // the arena, or their resources leak.
+    template <typename T, typename... Args>
+    T* make_unmanaged(Args&&... args) {
+        void* memory = storage->allocate(sizeof(T), alignof(T));
+        T* object = new (memory) T(std::forward<Args>(args)...);
+        storage->object_count++;
+        return object;
+    }
+
+    size_t object_count() const { return storage->object_count; }
+
+    // Bytes taken by objects (including alignment padding) and by their destructor entries.
+    size_t bytes_used() const {
+        return storage->bytes_used + storage->destructors.size() * sizeof(arena_storage::destructor);
+    }
+
+    double bytes_per_object() const {
+        return object_count() ? double(bytes_used()) / object_count() : 0;
+    }
+
+  private:
+    struct arena_storage {
+        struct destructor {
+            void* object;
+            void (*destroy)(void*);
+        };
+
+        size_t block_size;
+        std::vector<std::unique_ptr<std::byte[]>> blocks;
+        std::byte* cursor = nullptr;     // Next free byte in the current block
+        std::byte* block_end = nullptr;
+        std::vector<destructor> destructors;
+        size_t object_count = 0;
+        size_t bytes_used = 0;
+
+        explicit arena_storage(size_t block_size) : block_size(block_size) {}
+
+        ~arena_storage() {
+            // Reverse order, so objects built from earlier ones go first.
+            for (auto it = destructors.rbegin(); it != destructors.rend(); ++it)
+                it->destroy(it->object);
+        }
+
+        void* allocate(size_t size, size_t alignment) {
+            auto padding = cursor ? (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment : 0;
+            if (!cursor || padding + size > size_t(block_end - cursor)) {
+                // Oversized objects get a block of their own.
+                auto new_block_size = std::max(block_size, size + alignment);
+                blocks.push_back(std::make_unique<std::byte[]>(new_block_size));
+                cursor = blocks.back().get();
+                block_end = cursor + new_block_size;
+                padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+            }
+
+            void* result = cursor + padding;
+            cursor += padding + size;
+            bytes_used += padding + size;
+            return result;
+        }
+    };
+
+    std::unique_ptr<arena_storage> storage;
+};
+
+// Non-owning shared_ptr to an object kept alive elsewhere (an arena, a scene's material
+// palette), for APIs that take shared_ptrs (hittable_list, primitive constructors, hit
+// records). Copies cost no reference counting.
+template <typename T>
+std::shared_ptr<T> borrow(T* object) {
+    return std::shared_ptr<T>(std::shared_ptr<T>(), object);
+}
+
+#endif
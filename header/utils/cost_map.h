@@ -0,0 +1,105 @@
+#ifndef COST_MAP_H
+#define COST_MAP_H
+
+#include "utils/color.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+    Per-pixel render cost: wall time, rays traced, primitive and box intersection tests,
+    and the deepest bounce of any of the pixel's paths. A camera with a cost map attached
+    fills it while rendering (see camera::costs).
+
+    write() saves each metric twice: as a false-color PPM heatmap for looking at, and as a
+    single-channel PFM float image holding the raw values for further analysis.
+*/
+
+class cost_map {
+  public:
+    int width  = 0;
+    int height = 0;
+    std::vector<float> nanoseconds;
+    std::vector<float> rays;
+    std::vector<float> primitive_tests;
+    std::vector<float> box_tests;
+    std::vector<float> depth;
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        auto size = size_t(w) * size_t(h);
+        for (auto* metric : { &nanoseconds, &rays, &primitive_tests, &box_tests, &depth })
+            metric->assign(size, 0.0f);
+    }
+
+    // Writes <base>.<metric>.ppm and <base>.<metric>.pfm for every metric. Returns false if
+    // any file could not be written.
+    bool write(const std::string& base) const {
+        bool ok = true;
+        ok &= write_metric(base + ".time", nanoseconds);
+        ok &= write_metric(base + ".rays", rays);
+        ok &= write_metric(base + ".prim_tests", primitive_tests);
+        ok &= write_metric(base + ".box_tests", box_tests);
+        ok &= write_metric(base + ".depth", depth);
+        return ok;
+    }
+
+  private:
+    bool write_metric(const std::string& base, const std::vector<float>& values) const {
+        return write_heatmap(base + ".ppm", values) && write_pfm(base + ".pfm", values);
+    }
+
+    // Scaled to the 99th percentile rather than the maximum, so that a few extreme pixels
+    // don't wash out the rest of the map.
+    bool write_heatmap(const std::string& path, const std::vector<float>& values) const {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+
+        std::vector<float> sorted(values);
+        float scale = 0;
+        if (!sorted.empty()) {
+            auto nth = sorted.begin() + (sorted.size() - 1) * 99 / 100;
+            std::nth_element(sorted.begin(), nth, sorted.end());
+            scale = *nth;
+        }
+
+        out << "P3\n" << width << ' ' << height << "\n255\n";
+        for (float value : values) {
+            double x = scale > 0 ? std::min(1.0, value / double(scale)) : 0.0;
+            color c = false_color(x);
+            out << int(255.999 * c.x()) << ' ' << int(255.999 * c.y()) << ' ' << int(255.999 * c.z()) << '\n';
+        }
+        return bool(out);
+    }
+
+    // Portable float map, one channel. Rows are stored bottom to top, little-endian (negative scale).
+    bool write_pfm(const std::string& path, const std::vector<float>& values) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+            return false;
+
+        out << "Pf\n" << width << ' ' << height << "\n-1.0\n";
+        for (int j = height - 1; j >= 0; j--)
+            out.write(reinterpret_cast<const char*>(&values[size_t(j) * width]), std::streamsize(width * sizeof(float)));
+        return bool(out);
+    }
+
+    // Black -> blue -> magenta -> red -> yellow -> white as x goes from 0 to 1.
+    static color false_color(double x) {
+        static const color stops[] = {
+            color(0, 0, 0), color(0, 0, 1), color(1, 0, 1), color(1, 0, 0), color(1, 1, 0), color(1, 1, 1)
+        };
+        const int segments = 5;
+        double position = x * segments;
+        int k = std::min(int(position), segments - 1);
+        double f = position - k;
+        return (1 - f) * stops[k] + f * stops[k + 1];
+    }
+};
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "utils/color.h"
+#include "utils/trace.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+    In-memory frame of linear (pre-gamma) colors. Renders fill it in any order, and the
+    whole frame is encoded once at the end, so scanlines no longer have to be produced
+    in output order.
+*/
+
+class image_buffer {
+  public:
+    int width  = 0;
+    int height = 0;
+    std::vector<color> pixels;
+
+    image_buffer() {}
+    image_buffer(int width, int height) { resize(width, height); }
+
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        pixels.assign(size_t(w) * size_t(h), color(0,0,0));
+    }
+
+    color& at(int i, int j)             { return pixels[size_t(j) * width + i]; }
+    const color& at(int i, int j) const { return pixels[size_t(j) * width + i]; }
+
+    void write_ppm(std::ostream& out) const {
+        TRACE_SCOPE("image encode");
+        out << "P3\n" << width << ' ' << height << "\n255\n";
+        for (const auto& pixel_color : pixels)
+            write_color(out, pixel_color);
+    }
+
+    bool write_ppm(const std::string& path) const {
+        // Encode first so the trace separates encoding from the file write.
+        std::ostringstream encoded;
+        write_ppm(encoded);
+
+        TRACE_SCOPE("file write");
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+            return false;
+        const auto& bytes = encoded.str();
+        out.write(bytes.data(), std::streamsize(bytes.size()));
+        return bool(out);
+    }
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef RANDOM_STREAM_H
+#define RANDOM_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/*
+    Batched uniform random numbers. xoshiro256+ is run as four independent lanes laid out
+    structure-of-arrays, so one step produces four outputs with the same handful of shifts,
+    xors and adds on every lane: with AVX2 that is one 256-bit register per state word, and
+    without it the plain loop over lanes is easy for the compiler to vectorize. Both paths
+    produce exactly the same numbers.
+
+    random_stream keeps a small buffer of these numbers per thread and hands them out one at a
+    time, so random_double() is just a buffer read until the buffer needs refilling.
+*/
+
+// splitmix64 step: advances `state` and returns a well-mixed 64-bit value.
+inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Seed for the stream of one camera sample. Hashing (seed, pixel, sample) together means a
+// sample's random numbers depend only on which sample it is, not on when or where it runs.
+inline uint64_t sample_stream_seed(uint64_t seed, uint64_t pixel, uint64_t sample) {
+    uint64_t state = seed;
+    state = splitmix64(state) ^ pixel;
+    state = splitmix64(state) ^ sample;
+    return splitmix64(state);
+}
+
+class xoshiro256x4 {
+  public:
+    static constexpr int lanes = 4;
+
+    xoshiro256x4(uint64_t seed = 0) { seed_lanes(seed); }
+
+    void seed_lanes(uint64_t seed) {
+        // Expand the seed with splitmix64, as recommended by the xoshiro authors, so that
+        // nearby seeds still give unrelated lane states.
+        for (int word = 0; word < 4; word++)
+            for (int lane = 0; lane < lanes; lane++)
+                s[word][lane] = splitmix64(seed);
+    }
+
+    // Fills out[0..count) with uniform doubles in [0,1). count must be a multiple of 4.
+    void fill(double* out, size_t count) {
+#if defined(__AVX2__)
+        __m256i s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s[0]));
+        __m256i s1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s[1]));
+        __m256i s2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s[2]));
+        __m256i s3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s[3]));
+        const __m256i exponent_one = _mm256_set1_epi64x(0x3FF0000000000000LL);
+        const __m256d one = _mm256_set1_pd(1.0);
+
+        for (size_t i = 0; i < count; i += lanes) {
+            __m256i result = _mm256_add_epi64(s0, s3);
+            __m256i t = _mm256_slli_epi64(s1, 17);
+
+            s2 = _mm256_xor_si256(s2, s0);
+            s3 = _mm256_xor_si256(s3, s1);
+            s1 = _mm256_xor_si256(s1, s2);
+            s0 = _mm256_xor_si256(s0, s3);
+            s2 = _mm256_xor_si256(s2, t);
+            s3 = _mm256_or_si256(_mm256_slli_epi64(s3, 45), _mm256_srli_epi64(s3, 19));
+
+            __m256i bits = _mm256_or_si256(_mm256_srli_epi64(result, 12), exponent_one);
+            _mm256_storeu_pd(out + i, _mm256_sub_pd(_mm256_castsi256_pd(bits), one));
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(s[0]), s0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(s[1]), s1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(s[2]), s2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(s[3]), s3);
+#else
+        for (size_t i = 0; i < count; i += lanes) {
+            for (int lane = 0; lane < lanes; lane++) {
+                uint64_t result = s[0][lane] + s[3][lane];
+                uint64_t t = s[1][lane] << 17;
+
+                s[2][lane] ^= s[0][lane];
+                s[3][lane] ^= s[1][lane];
+                s[1][lane] ^= s[2][lane];
+                s[0][lane] ^= s[3][lane];
+                s[2][lane] ^= t;
+                s[3][lane] = (s[3][lane] << 45) | (s[3][lane] >> 19);
+
+                out[i + lane] = to_unit_double(result);
+            }
+        }
+#endif
+    }
+
+  private:
+    alignas(32) uint64_t s[4][lanes];  // s[word][lane]
+
+    // Top 52 bits as the mantissa of a double in [1,2), shifted down to [0,1). This is the
+    // conversion the AVX2 path can do without 64-bit integer to double instructions.
+    static double to_unit_double(uint64_t x) {
+        uint64_t bits = (x >> 12) | 0x3FF0000000000000ULL;
+        double d;
+        std::memcpy(&d, &bits, sizeof(d));
+        return d - 1.0;
+    }
+};
+
+class random_stream {
+  public:
+    // Large enough to amortize the refill, small enough that reseeding for every camera
+    // sample (which discards the buffer) stays cheap.
+    static constexpr size_t buffer_size = 64;
+
+    random_stream(uint64_t seed = 0) : generator(seed) {}
+
+    void seed(uint64_t seed) {
+        generator.seed_lanes(seed);
+        next_index = buffer_size;  // Discard numbers drawn from the old state
+    }
+
+    double next() {
+        if (next_index == buffer_size) {
+            generator.fill(buffer, buffer_size);
+            next_index = 0;
+        }
+        return buffer[next_index++];
+    }
+
+  private:
+    xoshiro256x4 generator;
+    alignas(32) double buffer[buffer_size];
+    size_t next_index = buffer_size;
+};
+
+#endif
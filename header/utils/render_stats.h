@@ -0,0 +1,24 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <cstdint>
+
+/*
+    Per-thread work counters, bumped by the tracer as it runs. They are plain thread-local
+    integers, so counting costs one increment and never contends between threads; readers
+    take a snapshot before and after a unit of work and subtract.
+*/
+
+struct ray_counters {
+    uint64_t rays            = 0;  // Ray segments traced (camera rays and every bounce)
+    uint64_t primitive_tests = 0;  // Ray-primitive intersection tests
+    uint64_t box_tests       = 0;  // Ray-bounding box tests during BVH traversal
+    int      deepest_bounce  = 0;  // Deepest bounce reached since last reset
+};
+
+inline ray_counters& thread_counters() {
+    static thread_local ray_counters counters;
+    return counters;
+}
+
+#endif
@@ -1,12 +1,16 @@
 #ifndef RTWEEKEND_H
 #define RTWEEKEND_H
 
+#include <atomic>
 #include <cmath>
 #include <iostream>
 #include <limits>
 #include <memory>
 #include <random>
 
+#include "utils/random_stream.h"
+#include "utils/render_stats.h"
+
 // C++ Std Usings
 using std::make_shared;
 using std::shared_ptr;
@@ -20,8 +24,26 @@ inline double degrees_to_radians(double degrees) {
     return degrees * pi / 180.0;
 }
 
+// Each thread owns its own generator so that concurrent renders never share (or race on) RNG state.
+// Numbers are generated in SIMD batches into a per-thread buffer (see random_stream.h). Streams
+// start from distinct seeds, so pool threads that never reseed still draw unrelated numbers.
+inline uint64_t next_thread_seed() {
+    static std::atomic<uint64_t> threads_seeded{0};
+    uint64_t state = threads_seeded.fetch_add(1);
+    return splitmix64(state);
+}
+
+inline random_stream& thread_random_stream() {
+    static thread_local random_stream stream(next_thread_seed());
+    return stream;
+}
+
+inline void seed_random(uint64_t seed) {
+    thread_random_stream().seed(seed);
+}
+
 inline double random_double() {
-    return rand() / (RAND_MAX + 1.0);
+    return thread_random_stream().next();
 }
 
 // Overload to handle min and max range
@@ -34,5 +56,6 @@ inline double random_double(double min, double max) {
 #include "core/ray.h"
 #include "core/vec3.h"
 #include "core/interval.h"  // Ensure interval.h is included here safely
+#include "core/aabb.h"
 
 #endif
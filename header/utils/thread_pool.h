@@ -0,0 +1,103 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    Fixed-size pool of worker threads pulling tasks from one shared FIFO queue.
+    Several renders can feed the same pool at once; each waits on its own task_group.
+*/
+
+class thread_pool {
+  public:
+    explicit thread_pool(unsigned int thread_count = std::thread::hardware_concurrency()) {
+        if (thread_count == 0) thread_count = 1;
+        for (unsigned int i = 0; i < thread_count; i++)
+            workers.emplace_back([this] { worker_loop(); });
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        queue_ready.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            tasks.push_back(std::move(task));
+        }
+        queue_ready.notify_one();
+    }
+
+  private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex queue_mutex;
+    std::condition_variable queue_ready;
+    bool stopping = false;
+
+    void worker_loop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+// Tracks a batch of tasks submitted to a pool so the submitter can block until all of them finish.
+class task_group {
+  public:
+    explicit task_group(thread_pool& pool) : pool(pool) {}
+
+    ~task_group() { wait(); }
+
+    void run(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(count_mutex);
+            pending++;
+        }
+        pool.submit([this, task = std::move(task)] {
+            task();
+            std::lock_guard<std::mutex> lock(count_mutex);
+            if (--pending == 0)
+                all_done.notify_all();
+        });
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(count_mutex);
+        all_done.wait(lock, [this] { return pending == 0; });
+    }
+
+  private:
+    thread_pool& pool;
+    size_t pending = 0;
+    std::mutex count_mutex;
+    std::condition_variable all_done;
+};
+
+#endif
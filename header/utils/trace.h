@@ -0,0 +1,166 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+    Timeline tracing in the Chrome trace-event format (load the output in Perfetto or
+    chrome://tracing). TRACE_SCOPE("name") records a span from that line to the end of the
+    enclosing scope.
+
+    Tracing is compiled in only when RT_TRACE is defined (cmake -DRT_ENABLE_TRACE=ON);
+    otherwise TRACE_SCOPE expands to nothing and costs nothing. When compiled in, recording
+    also has to be switched on at run time with trace::enable(), and every thread appends
+    to its own buffer, so recording takes no locks. trace::write() must only be called once
+    the traced work has finished.
+
+    Each buffer keeps only the most recent max_spans spans, overwriting the oldest, so a
+    long-lived process (the render server) traces in bounded memory and the file shows the
+    latest work.
+*/
+
+#ifdef RT_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace trace {
+
+struct span {
+    const char* name;   // Must be a string literal (or otherwise outlive the trace)
+    int64_t     start;  // Nanoseconds since the trace epoch
+    int64_t     duration;
+};
+
+// About 6 MB of spans per thread.
+constexpr size_t max_spans = size_t(1) << 18;
+
+// A ring of at most max_spans spans; once full, each new span replaces the oldest.
+struct thread_buffer {
+    int               tid;
+    std::vector<span> spans;
+    size_t            next     = 0;   // Where the next span goes once the ring is full
+    uint64_t          recorded = 0;   // Every span ever recorded, kept or not
+
+    void push(const span& s) {
+        if (spans.size() < max_spans) {
+            spans.push_back(s);
+        } else {
+            spans[next] = s;
+            next = (next + 1) % max_spans;
+        }
+        recorded++;
+    }
+};
+
+struct recorder {
+    std::atomic<bool> enabled{false};
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    std::mutex registry_mutex;  // Taken once per thread, when its buffer is first created
+    std::vector<std::shared_ptr<thread_buffer>> buffers;
+};
+
+inline recorder& global_recorder() {
+    static recorder instance;
+    return instance;
+}
+
+// The calling thread's buffer. The registry shares ownership, so spans recorded by threads
+// that have since exited are still written out.
+inline thread_buffer& local_buffer() {
+    static thread_local std::shared_ptr<thread_buffer> buffer = [] {
+        auto& rec = global_recorder();
+        auto created = std::make_shared<thread_buffer>();
+        created->spans.reserve(4096);
+        std::lock_guard<std::mutex> lock(rec.registry_mutex);
+        created->tid = int(rec.buffers.size());
+        rec.buffers.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+inline int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - global_recorder().epoch).count();
+}
+
+// Registers the calling thread first, so that it is shown as "main".
+inline void enable() {
+    local_buffer();
+    global_recorder().enabled.store(true, std::memory_order_relaxed);
+}
+
+inline bool enabled() { return global_recorder().enabled.load(std::memory_order_relaxed); }
+
+class scope {
+  public:
+    explicit scope(const char* name) : name(name), start(enabled() ? now_ns() : -1) {}
+
+    ~scope() {
+        if (start >= 0)
+            local_buffer().push({name, start, now_ns() - start});
+    }
+
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+
+  private:
+    const char* name;
+    int64_t     start;
+};
+
+// Writes every kept span as a complete ("X") event, with timestamps in microseconds, and
+// notes on clog how many older spans were overwritten.
+inline bool write(const std::string& path) {
+    std::ofstream out(path);
+    if (!out)
+        return false;
+
+    auto& rec = global_recorder();
+    std::lock_guard<std::mutex> lock(rec.registry_mutex);
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    uint64_t overwritten = 0;
+    for (const auto& buffer : rec.buffers) {
+        overwritten += buffer->recorded - buffer->spans.size();
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":\"" << (buffer->tid == 0 ? "main" : "worker " + std::to_string(buffer->tid)) << "\"}}";
+        first = false;
+
+        for (const auto& s : buffer->spans) {
+            out << ",\n{\"name\":\"" << s.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":" << s.start / 1000.0 << ",\"dur\":" << s.duration / 1000.0 << '}';
+        }
+    }
+    out << "\n]}\n";
+
+    if (overwritten > 0)
+        std::clog << "Trace kept the latest " << max_spans << " spans per thread; "
+                  << overwritten << " older spans were overwritten\n";
+    return bool(out);
+}
+
+} // namespace trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) ::trace::scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name) do {} while (0)
+
+#endif
+
+#endif
@@ -1,127 +1,194 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <cstdlib>
+#include <fstream>
 // Include other headers that are unlikely to change
 #include "utils/rtweekend.h"      // For utility constants and functions
 #include "camera/camera.h"
-#include "objects/hittable.h"
-#include "objects/hittable_list.h"
-#include "objects/sphere.h"
-#include "objects/tetrahedron.h"
-#include "objects/cube.h"
-#include "objects/material.h"
-
-
-// int main() {
-//     hittable_list world;
-
-//     // Define materials
-//     auto material_ground = make_shared<lambertian>(color(0.2, 0.8, 0.2));
-//     auto material_center = make_shared<lambertian>(color(0.1, 0.2, 0.5));
-//     auto material_left   = make_shared<dielectric>(1.50);
-//     auto material_bubble = make_shared<dielectric>(1.00 / 1.50);
-//     auto material_right  = make_shared<metal>(color(0.8, 0.6, 0.2), 1.0);
-//     auto material_cube = make_shared<metal>(color(0.95, 0.64, 0.54), 1.0);  // Copper-like color and slight roughness
-//     auto material_tetra = make_shared<metal>(color(0.9, 0.2, 0.2), 0.8);  // Red metal with slight roughness
-
-//     // Add spheres
-//     world.add(make_shared<sphere>(point3( 0.0, -100.5, -1.0), 100.0, material_ground));
-//     world.add(make_shared<sphere>(point3( 0.0,    0.0, -1.2),   0.5, material_center));
-//     world.add(make_shared<sphere>(point3(-1.0,    0.0, -1.0),   0.5, material_left));
-//     world.add(make_shared<sphere>(point3(-1.0,    0.0, -1.0),   0.4, material_bubble));
-//     world.add(make_shared<sphere>(point3( 1.0,    0.0, -1.0),   0.5, material_right));
-
-//     // Add a floating cube
-//     world.add(std::make_shared<cube>(point3(-0.5, 0.5, -2.8), 1.0, material_cube));
-
-//     // Add a tetrahedron
-//     world.add(std::make_shared<tetrahedron>(
-//         point3(1.5, 0.0, -2.5),  // Base vertex
-//         point3(2.0, 0.0, -2.0),  // Second base vertex
-//         point3(1.5, 0.0, -3.0),  // Third base vertex
-//         point3(1.7, 1.0, -2.5),  // Apex vertex
-//         material_tetra
-//     ));
-
-//     // Setup camera
-//     camera cam;
-
-//     cam.aspect_ratio      = 16.0 / 9.0;
-//     cam.image_width       = 400;
-//     cam.samples_per_pixel = 100;
-//     cam.max_depth         = 50;
-
-//     cam.vfov     = 30;
-//     cam.lookfrom = point3(-2,2,1);
-//     cam.lookat   = point3(0,0,-1);
-//     cam.vup      = vec3(0,1,0);
-
-//     cam.defocus_angle = 10.0;
-//     cam.focus_dist    = 3.4;
-
-//     // Render the scene
-//     cam.render(world);
-
-//     return 0;
-// }
-
-int main() {
-    hittable_list world;
-
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0,-1000,0), 1000, ground_material));
-
-    for (int a = -11; a < 11; a++) {
-        for (int b = -11; b < 11; b++) {
-            auto choose_mat = random_double();
-            point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
-
-            if ((center - point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
-
-                if (choose_mat < 0.8) {
-                    // diffuse
-                    auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                } else if (choose_mat < 0.95) {
-                    // metal
-                    auto albedo = color::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                } else {
-                    // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-            }
+#include "camera/batch.h"
+#include "scene/scenes.h"
+#include "server/render_server.h"
+
+
+// Reads one view per line (camera keys from render_job.h plus output=<file>; blank lines and
+// '#' comments are skipped) and renders them all against one scene on a shared pool.
+static int render_views(scene& sc, const std::string& views_path, thread_pool& pool) {
+    std::ifstream in(views_path);
+    if (!in) {
+        std::clog << "Could not read " << views_path << '\n';
+        return 1;
+    }
+
+    std::vector<camera> views;
+    std::vector<std::string> outputs;
+    std::string line;
+    for (int line_number = 1; std::getline(in, line); line_number++) {
+        if (line.find_first_not_of(" \t") == std::string::npos || line[line.find_first_not_of(" \t")] == '#')
+            continue;
+
+        render_job job;
+        std::string error;
+        camera cam = sc.view;
+        if (!render_job::parse(line, job, error, false) || !job.apply(cam, error)) {
+            std::clog << views_path << ':' << line_number << ": " << error << '\n';
+            return 1;
         }
+
+        views.push_back(cam);
+        outputs.push_back(job.output_path.empty() ? "view" + std::to_string(outputs.size()) + ".ppm"
+                                                  : job.output_path);
     }
 
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0, 1, 0), 1.0, material1));
+    std::vector<image_buffer> images;
+    auto start = std::chrono::steady_clock::now();
+    render_batch(*sc.root, views, images, pool);
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-    auto material2 = make_shared<lambertian>(color(0.4, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-4, 1, 0), 1.0, material2));
+    int failures = 0;
+    for (size_t v = 0; v < views.size(); v++) {
+        if (!images[v].write_ppm(outputs[v])) {
+            std::clog << "Could not write " << outputs[v] << '\n';
+            failures++;
+        }
+    }
 
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(4, 1, 0), 1.0, material3));
+    std::clog << "Rendered " << views.size() << " views in " << ms << " ms\n";
+    return failures == 0 ? 0 : 1;
+}
 
-    camera cam;
+// Writes the recorded trace when main returns. Declared before anything that owns a thread
+// pool, so every worker has been joined by the time it runs.
+struct trace_output {
+    std::string path;
 
-    cam.aspect_ratio      = 16.0 / 9.0;
-    cam.image_width       = 1200;
-    cam.samples_per_pixel = 500;
-    cam.max_depth         = 50;
+    ~trace_output() {
+#ifdef RT_TRACE
+        if (!path.empty() && !trace::write(path))
+            std::clog << "Could not write trace to " << path << '\n';
+#endif
+    }
+};
+
+static void print_usage(const char* program) {
+    std::clog << "Usage:\n"
+              << "  " << program << "                                  render random_spheres to stdout as PPM\n"
+              << "  " << program << " --scene <name>                   render a named scene to stdout as PPM\n"
+              << "  " << program << " --time-budget <seconds>          render as many samples as fit in the budget\n"
+              << "  " << program << " --views <file>                   render every view listed in the file, one image each\n"
+              << "  " << program << " --heatmap <base>                 also write per-pixel cost maps to <base>.*.ppm/.pfm\n"
+              << "  " << program << " --trace <file.json>              record a Chrome trace (needs -DRT_ENABLE_TRACE=ON)\n"
+              << "  " << program << " --stream <dir> [--chunk N] [--cache-mb M]\n"
+              << "                                          trace a procedural scene out of core from chunks in <dir>\n"
+              << "  " << program << " --serve <socket> [--threads N]   run as a render server on a Unix socket\n"
+              << "Scenes:";
+    for (const auto& name : scene_names())
+        std::clog << ' ' << name;
+    std::clog << '\n';
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    std::string scene_name = "random_spheres";
+    std::string socket_path;
+    unsigned int threads = std::thread::hardware_concurrency();
+    double time_budget = 0;
+    std::string views_path;
+    std::string heatmap_base;
+    std::string trace_path;
+    std::string stream_dir;
+    size_t chunk_primitives = 65536;
+    size_t cache_mb = 256;
+
+    for (size_t i = 0; i < args.size(); i++) {
+        bool has_value = i + 1 < args.size();
+        if (args[i] == "--scene" && has_value) {
+            scene_name = args[++i];
+        } else if (args[i] == "--serve" && has_value) {
+            socket_path = args[++i];
+        } else if (args[i] == "--time-budget" && has_value) {
+            time_budget = std::atof(args[++i].c_str());
+        } else if (args[i] == "--views" && has_value) {
+            views_path = args[++i];
+        } else if (args[i] == "--heatmap" && has_value) {
+            heatmap_base = args[++i];
+        } else if (args[i] == "--trace" && has_value) {
+            trace_path = args[++i];
+        } else if (args[i] == "--stream" && has_value) {
+            stream_dir = args[++i];
+        } else if (args[i] == "--chunk" && has_value) {
+            chunk_primitives = size_t(std::atol(args[++i].c_str()));
+        } else if (args[i] == "--cache-mb" && has_value) {
+            cache_mb = size_t(std::atol(args[++i].c_str()));
+        } else if (args[i] == "--threads" && has_value) {
+            threads = unsigned(std::atoi(args[++i].c_str()));
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
 
-    cam.vfov     = 20;
-    cam.lookfrom = point3(13,2,3);
-    cam.lookat   = point3(0,0,0);
-    cam.vup      = vec3(0,1,0);
+    trace_output trace_file;
+    if (!trace_path.empty()) {
+#ifdef RT_TRACE
+        trace::enable();
+        trace_file.path = trace_path;
+#else
+        std::clog << "Tracing is not compiled in; rebuild with -DRT_ENABLE_TRACE=ON\n";
+#endif
+    }
 
-    cam.defocus_angle = 0.6;
-    cam.focus_dist    = 10.0;
+    if (!socket_path.empty()) {
+        render_server server(socket_path, threads);
+        return server.run() ? 0 : 1;
+    }
 
-    cam.render(world);
-}
\ No newline at end of file
+    // One pool for building the scene and rendering it, sized by --threads.
+    thread_pool pool(threads);
+    scene sc;
+    shared_ptr<chunked_scene> streamed;
+    if (!stream_dir.empty()) {
+        procedural_params params;
+        if (!parse_procedural_name(scene_name, params)) {
+            std::clog << "Only procedural scenes can be streamed\n";
+            return 1;
+        }
+        if (!procedural_streamed_scene(params, 0, stream_dir, chunk_primitives, cache_mb << 20, &pool, sc, streamed))
+            return 1;
+    } else if (!build_scene(scene_name, 0, sc, &pool)) {
+        std::clog << "Unknown scene '" << scene_name << "'\n";
+        print_usage(argv[0]);
+        return 1;
+    }
+    // Reports cache behaviour however the render below returns.
+    struct stream_report {
+        const shared_ptr<chunked_scene>& streamed;
+        ~stream_report() { if (streamed) streamed->report(std::clog); }
+    } report_stream{streamed};
+
+    if (!views_path.empty())
+        return render_views(sc, views_path, pool);
+
+    cost_map costs;
+    if (!heatmap_base.empty())
+        sc.view.costs = &costs;
+
+    if (time_budget > 0) {
+        // A budget only means something relative to all cores, so render on the pool.
+        image_buffer img;
+        budget_report report;
+        sc.view.samples_per_pixel = std::numeric_limits<int>::max() / 2;
+        sc.view.render(*sc.root, img, time_budget, &pool, &report);
+        report.print(std::clog);
+        img.write_ppm(std::cout);
+    } else {
+        sc.view.render(*sc.root);
+    }
+
+    if (!heatmap_base.empty() && !costs.write(heatmap_base)) {
+        std::clog << "Could not write cost maps to " << heatmap_base << ".*\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,363 @@
+// Micro-benchmarks for the hot inner kernels of the tracer.
+//
+//   rt_bench [iterations]
+//
+// Each kernel is timed over the same number of calls and reported in nanoseconds per call.
+// Where a kernel replaced an older implementation, the old one is kept here as "legacy" so
+// the before/after numbers come from the same build.
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "utils/rtweekend.h"
+#include "objects/hittable.h"
+#include "objects/material.h"
+#include "objects/tetrahedron.h"
+#include "objects/sphere.h"
+#include "objects/bvh.h"
+#include "objects/cube.h"
+#include "utils/arena.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace legacy {
+
+// One-at-a-time generator and rejection samplers, as they were before batched sampling.
+inline double random_double() {
+    // Returns a random real in [0,1).
+    return std::rand() / (RAND_MAX + 1.0);
+}
+
+inline vec3 random_unit_vector() {
+    while (true) {
+        auto p = vec3(2*random_double() - 1, 2*random_double() - 1, 2*random_double() - 1);
+        auto lensq = p.length_squared();
+        if (1e-160 < lensq && lensq <= 1)
+            return p / std::sqrt(lensq);
+    }
+}
+
+inline vec3 random_in_unit_disk() {
+    while (true) {
+        auto p = vec3(2*random_double() - 1, 2*random_double() - 1, 0);
+        if (p.length_squared() < 1)
+            return p;
+    }
+}
+
+// Four independent Möller-Trumbore triangle tests, as tetrahedron::hit was before it became
+// a convex_polyhedron.
+class tetrahedron {
+  public:
+    point3 v0, v1, v2, v3;
+    shared_ptr<material> mat_ptr;
+
+    tetrahedron(point3 v0, point3 v1, point3 v2, point3 v3, shared_ptr<material> m)
+        : v0(v0), v1(v1), v2(v2), v3(v3), mat_ptr(m) {}
+
+    bool ray_intersect_triangle(const ray& r, const point3& v0, const point3& v1, const point3& v2, interval ray_t, hit_record& rec) const {
+        vec3 edge1 = v1 - v0;
+        vec3 edge2 = v2 - v0;
+        vec3 h = cross(r.direction(), edge2);
+        double a = dot(edge1, h);
+        if (a > -1e-8 && a < 1e-8)
+            return false;
+
+        double f = 1.0 / a;
+        vec3 s = r.origin() - v0;
+        double u = f * dot(s, h);
+        if (u < 0.0 || u > 1.0)
+            return false;
+
+        vec3 q = cross(s, edge1);
+        double v = f * dot(r.direction(), q);
+        if (v < 0.0 || u + v > 1.0)
+            return false;
+
+        double t = f * dot(edge2, q);
+        if (t > ray_t.min && t < ray_t.max) {
+            rec.t = t;
+            rec.p = r.at(t);
+            rec.normal = cross(edge1, edge2);
+            rec.mat = mat_ptr;
+            return true;
+        }
+        return false;
+    }
+
+    bool hit(const ray& r, interval ray_t, hit_record& rec) const {
+        bool hit_anything = false;
+        hit_record temp_rec;
+
+        hit_anything |= ray_intersect_triangle(r, v0, v1, v2, ray_t, temp_rec);
+        if (hit_anything) { ray_t.max = temp_rec.t; rec = temp_rec; }
+        hit_anything |= ray_intersect_triangle(r, v0, v1, v3, ray_t, temp_rec);
+        if (hit_anything) { ray_t.max = temp_rec.t; rec = temp_rec; }
+        hit_anything |= ray_intersect_triangle(r, v1, v2, v3, ray_t, temp_rec);
+        if (hit_anything) { ray_t.max = temp_rec.t; rec = temp_rec; }
+        hit_anything |= ray_intersect_triangle(r, v2, v0, v3, ray_t, temp_rec);
+        if (hit_anything) { ray_t.max = temp_rec.t; rec = temp_rec; }
+
+        return hit_anything;
+    }
+};
+
+// aabb::hit and cube::hit as they were before rays carried their reciprocal direction: a
+// division and a branch on the sign per axis per test.
+inline bool aabb_hit(const aabb& box, const ray& r, interval ray_t) {
+    const point3& ray_orig = r.origin();
+    const vec3&   ray_dir  = r.direction();
+
+    for (int axis = 0; axis < 3; axis++) {
+        const interval& ax = box.axis_interval(axis);
+        const double adinv = 1.0 / ray_dir[axis];
+
+        auto t0 = (ax.min - ray_orig[axis]) * adinv;
+        auto t1 = (ax.max - ray_orig[axis]) * adinv;
+
+        if (t0 < t1) {
+            if (t0 > ray_t.min) ray_t.min = t0;
+            if (t1 < ray_t.max) ray_t.max = t1;
+        } else {
+            if (t1 > ray_t.min) ray_t.min = t1;
+            if (t0 < ray_t.max) ray_t.max = t0;
+        }
+
+        if (ray_t.max <= ray_t.min)
+            return false;
+    }
+    return true;
+}
+
+inline bool cube_hit(const point3& min_corner, const point3& max_corner, const shared_ptr<material>& mat,
+                     const ray& r, interval ray_t, hit_record& rec) {
+    thread_counters().primitive_tests++;
+
+    auto t_min = ray_t.min;
+    auto t_max = ray_t.max;
+    vec3 normal;
+
+    for (int i = 0; i < 3; ++i) {
+        auto inv_dir = 1.0 / r.direction()[i];
+        auto t0 = (min_corner[i] - r.origin()[i]) * inv_dir;
+        auto t1 = (max_corner[i] - r.origin()[i]) * inv_dir;
+
+        if (inv_dir < 0.0) std::swap(t0, t1);
+
+        if (t0 > t_min) {
+            t_min = t0;
+            normal = vec3(0, 0, 0);
+            normal[i] = inv_dir > 0 ? -1 : 1;
+        }
+
+        if (t1 < t_max) {
+            t_max = t1;
+        }
+
+        if (t_min > t_max) return false;
+    }
+
+    rec.t = t_min;
+    rec.p = r.at(rec.t);
+    rec.set_face_normal(r, normal);
+    rec.mat = mat;
+    return true;
+}
+
+} // namespace legacy
+
+// A fixed set of rays aimed from a shell around the origin at points near it, so that
+// roughly half of them hit a unit-sized primitive centered there.
+std::vector<ray> make_test_rays(size_t count) {
+    std::vector<ray> rays;
+    rays.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        point3 origin = 4 * random_unit_vector();
+        point3 target = 0.8 * random_unit_vector();
+        rays.emplace_back(origin, target - origin);
+    }
+    return rays;
+}
+
+template <typename Kernel>
+void bench(const std::string& name, long iterations, Kernel kernel) {
+    double sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++)
+        sink += kernel();
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    // Printing the sink keeps the compiler from discarding the work.
+    std::cout << std::left << std::setw(36) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(2)
+              << elapsed / iterations << " ns/call   (checksum " << std::setprecision(3) << sink << ")\n";
+}
+
+// Bytes currently allocated on the heap, or 0 where the C library can't tell us.
+size_t heap_bytes() {
+#ifdef __GLIBC__
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+// The two allocation strategies compared by build_scene_bench.
+struct heap_allocator {
+    template <typename T, typename... Args>
+    shared_ptr<T> create(Args&&... args) { return make_shared<T>(std::forward<Args>(args)...); }
+    shared_ptr<hittable> bvh(hittable_list& world) { return make_shared<bvh_node>(world); }
+    void clear(hittable_list& world, shared_ptr<hittable>& root) { root.reset(); world.clear(); }
+};
+
+struct arena_allocator {
+    std::unique_ptr<scene_arena> arena = std::make_unique<scene_arena>();
+    template <typename T, typename... Args>
+    shared_ptr<T> create(Args&&... args) { return borrow(arena->make_unmanaged<T>(std::forward<Args>(args)...)); }
+    shared_ptr<hittable> bvh(hittable_list& world) { return borrow(arena->make_unmanaged<bvh_node>(world, arena.get())); }
+    void clear(hittable_list& world, shared_ptr<hittable>& root) {
+        root.reset();
+        world.clear();
+        arena.reset();
+    }
+};
+
+// Builds a field of spheres sharing a handful of materials plus a BVH over them, then tears
+// it all down. Allocator is heap_allocator or arena_allocator.
+template <typename Allocator>
+void build_scene_bench(const std::string& name, size_t count, Allocator alloc) {
+    auto start = std::chrono::steady_clock::now();
+    auto heap_before = heap_bytes();
+
+    hittable_list world;
+    std::vector<shared_ptr<material>> materials;
+    for (int i = 0; i < 16; i++)
+        materials.push_back(alloc.template create<lambertian>(color(i / 16.0, 0.5, 0.5)));
+    for (size_t i = 0; i < count; i++) {
+        point3 center(random_double(-1000, 1000), random_double(-1000, 1000), random_double(-1000, 1000));
+        world.add(alloc.template create<sphere>(center, 0.5, materials[i & 15]));
+    }
+    auto root = alloc.bvh(world);
+
+    auto heap_after = heap_bytes();
+    auto end_build = std::chrono::steady_clock::now();
+    alloc.clear(world, root);
+    auto end = std::chrono::steady_clock::now();
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout << std::left << std::setw(36) << name
+              << std::right << std::setw(8) << std::fixed << std::setprecision(0)
+              << ms(end_build - start).count() << " ms build, "
+              << std::setw(6) << ms(end - end_build).count() << " ms teardown, "
+              << std::setprecision(1) << double(heap_after - heap_before) / count
+              << " heap bytes per primitive\n";
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? std::atol(argv[1]) : 10000000;
+
+    std::cout << "Sampling kernels, " << iterations << " calls each\n";
+
+    bench("random_double (legacy rand)", iterations, [] { return legacy::random_double(); });
+    bench("random_double (batched xoshiro)", iterations, [] { return random_double(); });
+
+    // Kernels returning vectors sum every component, so none of the work can be optimized away.
+    bench("random_unit_vector (legacy)", iterations, [] { auto v = legacy::random_unit_vector(); return v.x() + v.y() + v.z(); });
+    bench("random_unit_vector", iterations, [] { auto v = random_unit_vector(); return v.x() + v.y() + v.z(); });
+
+    bench("random_in_unit_disk (legacy)", iterations, [] { auto v = legacy::random_in_unit_disk(); return v.x() + v.y(); });
+    bench("random_in_unit_disk", iterations, [] { auto v = random_in_unit_disk(); return v.x() + v.y(); });
+
+    bench("random_cosine_direction", iterations, [] { auto v = random_cosine_direction(); return v.x() + v.y() + v.z(); });
+
+    // One diffuse bounce: the sampling cost every lambertian hit pays.
+    lambertian diffuse(color(0.5, 0.5, 0.5));
+    hit_record rec;
+    rec.p = point3(0,0,0);
+    rec.normal = vec3(0,1,0);
+    rec.front_face = true;
+    ray r_in(point3(0,1,0), vec3(0,-1,0));
+    bench("lambertian::scatter", iterations, [&] {
+        color attenuation;
+        ray scattered;
+        diffuse.scatter(r_in, rec, attenuation, scattered);
+        return scattered.direction().y();
+    });
+
+    std::cout << "\nPrimitive intersection, " << iterations << " rays each\n";
+
+    auto rays = make_test_rays(4096);
+    auto metal_mat = make_shared<metal>(color(0.5, 0.5, 0.5), 0.0);
+    point3 p0(-0.5, -0.4, -0.5), p1(0.6, -0.4, -0.3), p2(0.0, -0.4, 0.6), p3(0.0, 0.7, 0.0);
+    legacy::tetrahedron old_tetra(p0, p1, p2, p3, metal_mat);
+    tetrahedron tetra(p0, p1, p2, p3, metal_mat);
+
+    size_t ray_index = 0;
+    auto next_ray = [&]() -> const ray& { return rays[ray_index++ & 4095]; };
+
+    bench("tetrahedron::hit (legacy)", iterations, [&] {
+        hit_record hrec;
+        return old_tetra.hit(next_ray(), interval(0.001, infinity), hrec) ? hrec.t : 0.0;
+    });
+    bench("tetrahedron::hit", iterations, [&] {
+        hit_record hrec;
+        return tetra.hit(next_ray(), interval(0.001, infinity), hrec) ? hrec.t : 0.0;
+    });
+
+    // A unit box turned 30 degrees about y, then tipped so that no face is axis-aligned.
+    vec3 axis_u(std::cos(pi/6), 0, -std::sin(pi/6));
+    vec3 axis_v = unit_vector(cross(vec3(0, std::cos(pi/9), std::sin(pi/9)), axis_u));
+    vec3 axis_w = cross(axis_u, axis_v);
+    oriented_box tilted_box(point3(0, 0, 0), axis_u, axis_v, axis_w, vec3(0.5, 0.5, 0.5), metal_mat);
+    bench("oriented_box::hit", iterations, [&] {
+        hit_record hrec;
+        return tilted_box.hit(next_ray(), interval(0.001, infinity), hrec) ? hrec.t : 0.0;
+    });
+
+    std::cout << "\nPrimitive sizes: sphere " << sizeof(sphere) << " bytes, cube " << sizeof(cube)
+              << ", tetrahedron " << sizeof(tetrahedron) << ", oriented_box " << sizeof(oriented_box)
+              << " (legacy tetrahedron " << sizeof(legacy::tetrahedron) << ")\n";
+
+    std::cout << "\nBox intersection, " << iterations << " rays each\n";
+
+    // Each pair starts from the same ray, so matching checksums show matching results.
+    aabb box(point3(-0.5, -0.5, -0.5), point3(0.5, 0.5, 0.5));
+    cube unit_cube(point3(0, 0, 0), 1.0, metal_mat);
+
+    ray_index = 0;
+    bench("aabb::hit (legacy)", iterations, [&] {
+        return legacy::aabb_hit(box, next_ray(), interval(0.001, infinity)) ? 1.0 : 0.0;
+    });
+    ray_index = 0;
+    bench("aabb::hit", iterations, [&] {
+        return box.hit(next_ray(), interval(0.001, infinity)) ? 1.0 : 0.0;
+    });
+    ray_index = 0;
+    bench("cube::hit (legacy)", iterations, [&] {
+        hit_record hrec;
+        return legacy::cube_hit(point3(-0.5, -0.5, -0.5), point3(0.5, 0.5, 0.5), metal_mat, next_ray(),
+                                interval(0.001, infinity), hrec) ? hrec.t : 0.0;
+    });
+    ray_index = 0;
+    bench("cube::hit", iterations, [&] {
+        hit_record hrec;
+        return unit_cube.hit(next_ray(), interval(0.001, infinity), hrec) ? hrec.t : 0.0;
+    });
+
+    // What each ray now pays up front for the reciprocal and signs.
+    bench("ray construction", iterations, [&] {
+        const ray& r = next_ray();
+        return ray(r.origin(), r.direction()).inverse_direction().x();
+    });
+
+    std::cout << "\nScene construction, 1000000 spheres plus BVH\n";
+
+    build_scene_bench("make_shared per object", 1000000, heap_allocator());
+    build_scene_bench("scene_arena", 1000000, arena_allocator());
+}
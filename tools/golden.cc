@@ -0,0 +1,317 @@
+// Golden-image regression check and timing baseline.
+//
+//   rt_golden [--update] [--threads N] [--golden-dir DIR]
+//
+// Renders each reference scene at a small, fixed size with deterministic sampling: by scanline
+// on one thread and on N threads, in tiles (render_batch) on N threads, and as a time-budgeted
+// render on N threads whose budget is never reached, so samples_per_pixel ends it. All four
+// must be byte-identical (sampling must not depend on scheduling, tile order or passes), and
+// must match DIR/<scene>.ppm byte for byte. Then an incremental_renderer's frame is checked
+// against a full render after a lambertian albedo edit, a metal fuzz edit and a sky edit. --update rewrites
+// the golden images instead of comparing. Rays starting inside cubes (as refracted rays in glass
+// do) must hit the exit face. A small procedural field rendered out of core through a cache
+// smaller than one chunk must match its in-core render. Render times are printed for both
+// thread counts, so the same run doubles as a performance baseline.
+//
+// Exits non-zero if any comparison fails.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "utils/rtweekend.h"
+#include "scene/scenes.h"
+#include "camera/batch.h"
+#include "camera/incremental.h"
+#include "objects/cube.h"
+
+#ifndef RT_GOLDEN_DIR
+#define RT_GOLDEN_DIR "golden"
+#endif
+
+static std::string encode(const image_buffer& img) {
+    std::ostringstream ppm;
+    img.write_ppm(ppm);
+    return ppm.str();
+}
+
+static bool read_file(const std::string& path, std::string& contents) {
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+enum class schedule { scanlines, tiles, budget };
+
+// Renders the scene and returns the encoded image and the wall time in milliseconds.
+static std::string render_timed(const scene& sc, const camera& view, unsigned int threads, schedule how,
+                                double& ms) {
+    thread_pool pool(threads);
+    camera cam = view;
+    image_buffer img;
+
+    auto start = std::chrono::steady_clock::now();
+    if (how == schedule::scanlines) {
+        cam.render(*sc.root, img, &pool);
+    } else if (how == schedule::tiles) {
+        // Tiles smaller than the image, and not dividing it, so edge tiles are partial.
+        std::vector<camera> views{ cam };
+        std::vector<image_buffer> images;
+        render_batch(*sc.root, views, images, pool, 24);
+        img = std::move(images[0]);
+    } else {
+        cam.render(*sc.root, img, 1e6, &pool);
+    }
+    ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    return encode(img);
+}
+
+// Materials seen along a fan of rays from the camera toward its target, in the order first hit.
+static std::vector<material*> visible_materials(const scene& sc, const camera& view) {
+    std::vector<material*> found;
+    vec3 forward = unit_vector(view.lookat - view.lookfrom);
+    vec3 right = unit_vector(cross(forward, view.vup));
+    vec3 up = cross(right, forward);
+    for (int y = -4; y <= 4; y++) {
+        for (int x = -6; x <= 6; x++) {
+            hit_record rec;
+            ray r(view.lookfrom, forward + 0.05*x*right + 0.05*y*up);
+            if (sc.root->hit(r, interval(0.001, infinity), rec)
+                && std::find(found.begin(), found.end(), rec.mat.get()) == found.end())
+                found.push_back(rec.mat.get());
+        }
+    }
+    return found;
+}
+
+// Edits a lambertian, a metal and the sky in turn; after each, the incremental update must match
+// a full render of the edited scene. Returns an empty string on success, else what failed.
+static std::string check_incremental(const scene& sc, const camera& view, unsigned int threads) {
+    thread_pool pool(threads);
+    incremental_renderer incremental(view, *sc.root, &pool);
+    incremental.update();  // Before any render: must be a harmless no-op
+    incremental.render();
+
+    auto full_render = [&] {
+        camera cam = incremental.view();
+        image_buffer img;
+        cam.render(*sc.root, img, &pool);
+        return encode(img);
+    };
+
+    lambertian* diffuse = nullptr;
+    metal* shiny = nullptr;
+    for (auto* mat : visible_materials(sc, view)) {
+        if (!diffuse) diffuse = dynamic_cast<lambertian*>(mat);
+        if (!shiny)   shiny = dynamic_cast<metal*>(mat);
+    }
+    if (!diffuse || !shiny)
+        return "no visible lambertian and metal to edit";
+
+    diffuse->set_albedo(color(0.9, 0.1, 0.1));
+    if (incremental.material_changed(diffuse) == 0 || encode(incremental.update()) != full_render())
+        return "incremental update after set_albedo differs from full render";
+
+    shiny->set_fuzz(0.5);
+    if (incremental.material_changed(shiny) == 0 || encode(incremental.update()) != full_render())
+        return "incremental update after set_fuzz differs from full render";
+
+    incremental.view().sky_top = color(1.0, 0.6, 0.3);
+    if (incremental.sky_changed() == 0 || encode(incremental.update()) != full_render())
+        return "incremental update after a sky edit differs from full render";
+
+    return "";
+}
+
+// Rays from inside a cube, both the cube class and a compact_scene cube, must hit the face they
+// leave through, with a nonzero normal facing back at them; a ray whose whole interval is inside
+// must miss. Returns an empty string on success, else what failed.
+static std::string check_inside_rays() {
+    auto mat = make_shared<lambertian>(color(0.5, 0.5, 0.5));
+    cube single(point3(0, 0, 0), 2.0, mat);
+
+    compact_scene field;
+    field.materials.push_back(mat);
+    field.cubes.push_back({ { 0, 0, 0 }, 1.0f, 0 });
+    field.build_acceleration();
+
+    const vec3 directions[] = { vec3(1, 0, 0), vec3(0, -1, 0), vec3(0.3, 0.2, -1), vec3(-1, 1, 1) };
+    for (const hittable* object : std::initializer_list<const hittable*>{ &single, &field }) {
+        for (const auto& dir : directions) {
+            ray r(point3(0.1, 0.2, -0.1), dir);
+            hit_record rec;
+            if (!object->hit(r, interval(0.001, infinity), rec))
+                return "ray from inside a cube misses it";
+
+            // The exit point is on the surface, where the largest coordinate is the half side.
+            auto p = rec.p;
+            double extent = std::max({ std::fabs(p.x()), std::fabs(p.y()), std::fabs(p.z()) });
+            if (std::fabs(extent - 1.0) > 1e-6 || rec.normal.length_squared() < 0.5 || rec.front_face
+                || dot(rec.normal, dir) >= 0)
+                return "ray from inside a cube does not hit its exit face";
+
+            if (object->hit(r, interval(0.001, 0.5), rec))
+                return "ray segment wholly inside a cube hits it";
+        }
+    }
+    return "";
+}
+
+// A small procedural field traced out of core, through a cache smaller than one chunk on several
+// threads, so that nearly every chunk visit evicts another and chunks still pinned by one ray are
+// retired rather than unmapped under it. The image must match the same field rendered in core.
+// Returns an empty string on success, else what failed.
+static std::string check_streamed(unsigned int threads, double& in_core_ms, double& streamed_ms) {
+    procedural_params params;
+    params.count = 20000;
+
+    auto dir = std::filesystem::temp_directory_path() / ("rt_golden_chunks_" + std::to_string(::getpid()));
+    std::error_code error;
+    std::filesystem::create_directories(dir, error);
+    if (error)
+        return "could not create " + dir.string();
+
+    thread_pool pool(threads);
+    scene in_core = procedural_scene(params, 0, &pool);
+    scene streamed;
+    shared_ptr<chunked_scene> chunks;
+    bool opened = procedural_streamed_scene(params, 0, dir.string(), 512, 1, &pool, streamed, chunks);
+
+    std::string failure;
+    if (!opened) {
+        failure = "could not write or open chunks in " + dir.string();
+    } else {
+        camera view = in_core.view;
+        view.image_width       = 160;
+        view.samples_per_pixel = 4;
+        view.max_depth         = 8;
+        view.deterministic     = true;
+        view.seed              = 1;
+
+        auto expected = render_timed(in_core, view, threads, schedule::scanlines, in_core_ms);
+        auto actual   = render_timed(streamed, view, threads, schedule::scanlines, streamed_ms);
+        if (chunks->stats().evictions == 0)
+            failure = "streamed render never evicted a chunk";
+        else if (actual != expected)
+            failure = "streamed render differs from in-core render";
+    }
+
+    chunks.reset();
+    streamed = scene();
+    std::filesystem::remove_all(dir, error);
+    return failure;
+}
+
+int main(int argc, char* argv[]) {
+    bool update = false;
+    unsigned int threads = std::thread::hardware_concurrency();
+    std::string golden_dir = RT_GOLDEN_DIR;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--update") {
+            update = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = unsigned(std::atoi(argv[++i]));
+        } else if (arg == "--golden-dir" && i + 1 < argc) {
+            golden_dir = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--update] [--threads N] [--golden-dir DIR]\n";
+            return 1;
+        }
+    }
+    if (threads < 2)
+        threads = 2;  // Always compare against a real multi-threaded schedule
+
+    int failures = 0;
+    std::cout << std::left << std::setw(16) << "scene"
+              << std::right << std::setw(12) << "1 thread" << std::setw(12) << (std::to_string(threads) + " threads")
+              << std::setw(12) << "tiles" << std::setw(12) << "budget" << "  result\n";
+
+    // Reference scenes, listed explicitly so that registering a new scene doesn't change the check.
+    for (const std::string name : { "random_spheres", "showcase" }) {
+        scene sc;
+        build_scene(name, 0, sc);
+
+        // Small enough to run in seconds, large enough to exercise every material.
+        camera view = sc.view;
+        view.image_width       = 160;
+        view.samples_per_pixel = 16;
+        view.max_depth         = 16;
+        view.deterministic     = true;
+        view.seed              = 1;
+
+        double serial_ms, parallel_ms, tiles_ms, budget_ms;
+        auto serial   = render_timed(sc, view, 1, schedule::scanlines, serial_ms);
+        auto parallel = render_timed(sc, view, threads, schedule::scanlines, parallel_ms);
+        auto tiles    = render_timed(sc, view, threads, schedule::tiles, tiles_ms);
+        auto budget   = render_timed(sc, view, threads, schedule::budget, budget_ms);
+
+        std::string result;
+        auto path = golden_dir + "/" + name + ".ppm";
+        std::string golden;
+
+        if (serial != parallel) {
+            result = "FAIL (differs between 1 and " + std::to_string(threads) + " threads)";
+        } else if (serial != tiles) {
+            result = "FAIL (tile render differs from scanline render)";
+        } else if (serial != budget) {
+            result = "FAIL (time-budgeted render differs from full render)";
+        } else if (update) {
+            std::ofstream out(path);
+            out << serial;
+            result = out ? "updated " + path : "FAIL (could not write " + path + ")";
+        } else if (!read_file(path, golden)) {
+            result = "FAIL (missing " + path + ", run with --update)";
+        } else if (golden != serial) {
+            result = "FAIL (differs from " + path + ")";
+        } else {
+            result = "ok";
+        }
+
+        // Last, since it edits the scene's materials.
+        if (result.compare(0, 4, "FAIL") != 0) {
+            auto incremental_failure = check_incremental(sc, view, threads);
+            if (!incremental_failure.empty())
+                result = "FAIL (" + incremental_failure + ")";
+        }
+
+        if (result.compare(0, 4, "FAIL") == 0)
+            failures++;
+
+        std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << serial_ms << "ms" << std::setw(10) << parallel_ms << "ms"
+                  << std::setw(10) << tiles_ms << "ms" << std::setw(10) << budget_ms << "ms"
+                  << "  " << result << '\n';
+    }
+
+    auto inside_failure = check_inside_rays();
+    std::cout << std::left << std::setw(16) << "inside rays" << std::right << std::setw(48) << ""
+              << "  " << (inside_failure.empty() ? "ok" : "FAIL (" + inside_failure + ")") << '\n';
+    if (!inside_failure.empty())
+        failures++;
+
+    double in_core_ms = 0, streamed_ms = 0;
+    auto streamed_failure = check_streamed(threads, in_core_ms, streamed_ms);
+    std::cout << std::left << std::setw(16) << "streamed" << std::right << std::setw(48) << ""
+              << "  " << (streamed_failure.empty() ? "ok" : "FAIL (" + streamed_failure + ")")
+              << " (in core " << in_core_ms << "ms, streamed " << streamed_ms << "ms)\n";
+    if (!streamed_failure.empty())
+        failures++;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+// Command-line client for the render server (CppRayTracer --serve <socket>).
+//
+//   render_client <socket> scene=random_spheres width=320 spp=10 > thumb.ppm
+//   render_client <socket> scene=showcase output=/tmp/showcase.ppm
+//   render_client <socket> stats
+//   render_client <socket> shutdown
+//
+// Arguments after the socket path are joined into one request line (see header/server/render_job.h).
+// An image returned over the socket is written to stdout; every reply line goes to stderr.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "server/socket_io.h"
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <socket> <key=value>... | stats | shutdown\n";
+        return 1;
+    }
+
+    std::string request;
+    for (int i = 2; i < argc; i++) {
+        if (i > 2) request += ' ';
+        request += argv[i];
+    }
+
+    int fd = connect_unix_socket(argv[1]);
+    if (fd < 0) {
+        std::cerr << "Could not connect to " << argv[1] << '\n';
+        return 1;
+    }
+
+    std::string reply;
+    if (!write_all(fd, request + "\n") || !read_line(fd, reply)) {
+        std::cerr << "Connection closed by server\n";
+        ::close(fd);
+        return 1;
+    }
+
+    std::cerr << reply << '\n';
+
+    // "ok ppm=<bytes> ..." is followed by the image itself.
+    const std::string ppm_prefix = "ok ppm=";
+    if (reply.compare(0, ppm_prefix.size(), ppm_prefix) == 0) {
+        size_t size = std::stoul(reply.substr(ppm_prefix.size()));
+        std::vector<char> payload(size);
+        if (!read_exact(fd, payload.data(), size)) {
+            std::cerr << "Image truncated\n";
+            ::close(fd);
+            return 1;
+        }
+        std::cout.write(payload.data(), std::streamsize(size));
+    }
+
+    ::close(fd);
+    return reply.compare(0, 2, "ok") == 0 ? 0 : 1;
+}
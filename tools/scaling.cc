@@ -0,0 +1,87 @@
+// Scaling benchmark for the procedural scene generator.
+//
+//   rt_scaling [--threads N] [--rays R] [--clustering C] [count ...]
+//
+// For each primitive count (default 1e3 .. 1e6) this generates a procedural scene, builds its
+// BVH, and traces R closest-hit rays (default 200000) from above the field towards random
+// points on it, on N threads. It reports generation and build time, memory per primitive
+// and tracing throughput, so their growth with scene size can be compared.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utils/rtweekend.h"
+#include "scene/procedural.h"
+
+int main(int argc, char* argv[]) {
+    unsigned int threads = std::thread::hardware_concurrency();
+    size_t ray_count = 200000;
+    procedural_params params;
+    std::vector<size_t> counts;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)         threads = unsigned(std::atoi(argv[++i]));
+        else if (arg == "--rays" && i + 1 < argc)       ray_count = size_t(std::atof(argv[++i]));
+        else if (arg == "--clustering" && i + 1 < argc) params.clustering = std::atof(argv[++i]);
+        else if (!arg.empty() && std::isdigit(static_cast<unsigned char>(arg[0])))
+            counts.push_back(size_t(std::atof(arg.c_str())));
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--threads N] [--rays R] [--clustering C] [count ...]\n";
+            return 1;
+        }
+    }
+    if (counts.empty())
+        counts = { 1000, 10000, 100000, 1000000 };
+
+    thread_pool pool(threads);
+
+    std::cout << std::setw(12) << "primitives" << std::setw(14) << "generate ms" << std::setw(12) << "build ms"
+              << std::setw(14) << "bytes/prim" << std::setw(12) << "Mrays/s" << '\n';
+
+    for (auto count : counts) {
+        params.count = count;
+        compact_scene field;
+        procedural_generator generator(params, 0);
+        procedural_stats stats;
+        generator.generate(field, &pool, &stats);
+
+        // Rays from a point above the field to uniformly spread targets on it.
+        double side = generator.field_size();
+        point3 eye(0, 0.5*side + 2, 0.5*side + 2);
+        std::atomic<size_t> hits{0};
+        size_t per_task = 4096;
+
+        auto start = std::chrono::steady_clock::now();
+        {
+            task_group group(pool);
+            for (size_t first = 0; first < ray_count; first += per_task) {
+                group.run([&, first] {
+                    random_stream rng(first);
+                    size_t local_hits = 0;
+                    for (size_t k = first; k < std::min(ray_count, first + per_task); k++) {
+                        point3 target((rng.next() - 0.5) * side, 0, (rng.next() - 0.5) * side);
+                        hit_record rec;
+                        if (field.hit(ray(eye, target - eye), interval(0.001, infinity), rec))
+                            local_hits++;
+                    }
+                    hits += local_hits;
+                });
+            }
+            group.wait();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(12) << stats.primitives << std::setw(14) << stats.generate_ms
+                  << std::setw(12) << stats.build_ms << std::setw(14) << stats.bytes_per_primitive()
+                  << std::setw(12) << std::setprecision(2) << ray_count / seconds / 1e6
+                  << "   (" << hits << " hits)\n";
+    }
+}